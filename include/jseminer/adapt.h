@@ -0,0 +1,50 @@
+/*
+MIT License
+
+Copyright (c) 2019 iagocq
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _JSEMINER_ADAPT_H_
+#define _JSEMINER_ADAPT_H_
+
+#include <inttypes.h>
+#include <jseminer/job.h>
+
+// Rates are measured over this many milliseconds before the difficulty is eased
+#define ADAPT_WINDOW 10000
+// The difficulty is raised early once a window has this many times the shares it should end with
+#define ADAPT_BURST 2
+// Weights are sent as 32-bit numbers
+#define ADAPT_MAX_SHIFT 31
+
+// Mines a stricter target than the client asked for, each share found standing for 2^shift of the client's
+typedef struct SHARE_ADAPTER {
+    double sharesPerSecond;
+    unsigned int shift;
+    uint64_t windowStart;
+    uint64_t windowShares;
+} SHARE_ADAPTER;
+
+void adapterInit(SHARE_ADAPTER *adapter, double sharesPerSecond);
+int adapterUpdate(SHARE_ADAPTER *adapter, uint64_t shares);
+unsigned int adaptJob(JOB *job, unsigned int shift, JOB *mined);
+
+#endif
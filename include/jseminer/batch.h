@@ -0,0 +1,53 @@
+/*
+MIT License
+
+Copyright (c) 2019 iagocq
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _JSEMINER_BATCH_H_
+#define _JSEMINER_BATCH_H_
+
+#include <jseminer/job.h>
+#include <jseminer/miner.h>
+#include <stdio.h>
+
+// Jobs kept in flight on every device, so the host handles one while the device works on the others
+#define BATCH_JOBS_PER_DEVICE 3
+#define BATCH_LINE_SIZE 256
+
+typedef struct BATCH_SLOT {
+    int active;
+    uint64_t line;
+    JOB job;
+    uint32_t jobData[16];
+    cl_command_queue queue;
+    cl_mem jobBuffer, resultBuffer;
+    cl_event readDone;
+    cl_ulong nonce;
+    // Points into the mapped result buffer on unified memory devices, at hostResult otherwise
+    uint8_t *result, *hostResult;
+    uint64_t *shares;
+    int shareCount;
+} BATCH_SLOT;
+
+int runBatch(CL_MINER *miner, size_t *workSize, FILE *input, int sharesPerJob);
+
+#endif
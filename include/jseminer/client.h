@@ -0,0 +1,75 @@
+/*
+MIT License
+
+Copyright (c) 2019 iagocq
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _JSEMINER_CLIENT_H_
+#define _JSEMINER_CLIENT_H_
+
+#include <jseminer/job.h>
+#include <jseminer/miner.h>
+#include <jseminer/netbuffer.h>
+#include <jseminer/socket.h>
+
+// Every message in client mode starts with one of these type bytes
+#define CLIENT_MSG_JOB 'J'         // pool -> miner, followed by a job packet
+#define CLIENT_MSG_ACK 'A'         // pool -> miner, followed by the share packet being acknowledged
+#define CLIENT_MSG_SHARE 'S'       // miner -> pool, followed by a share packet
+#define CLIENT_MSG_LEASE 'L'       // coordinator -> miner, followed by a lease packet
+#define CLIENT_MSG_DONE 'D'        // miner -> coordinator, followed by lease ID (4) and hashrate in H/s (8)
+#define CLIENT_MSG_LEASE_SHARE 'R' // miner -> coordinator, followed by lease ID (4) and a share packet
+
+#define LEASE_DONE_PACKET_SIZE 12
+#define LEASE_SHARE_PACKET_SIZE (4 + SHARE_PACKET_SIZE)
+
+#define CLIENT_MAX_PENDING 256
+#define CLIENT_BACKOFF_MIN 1000
+#define CLIENT_BACKOFF_MAX 60000
+// A connect that has not completed by then is abandoned and retried with backoff
+#define CLIENT_CONNECT_TIMEOUT 10000
+#define CLIENT_IDLE_SLEEP 100
+
+#define CLIENT_DISCONNECTED 0
+#define CLIENT_CONNECTING 1
+#define CLIENT_CONNECTED 2
+
+typedef struct POOL_CLIENT {
+    LSOCKET sock;
+    char *host;
+    unsigned short port;
+    int state;
+    uint64_t nextAttempt, backoff, connectDeadline;
+    // The socket never blocks, messages are collected and sent from these between rounds
+    NET_BUFFER in, out;
+    SHARE pending[CLIENT_MAX_PENDING];
+    int pendingCount;
+    JOB_QUEUE jobs;
+} POOL_CLIENT;
+
+void clientInit(POOL_CLIENT *client, char *host, unsigned short port);
+void clientPoll(POOL_CLIENT *client);
+void clientSubmitShare(POOL_CLIENT *client, SHARE *share);
+void clientReportLease(POOL_CLIENT *client, uint32_t leaseId, uint64_t hashrate);
+void clientClose(POOL_CLIENT *client);
+int runClient(CL_MINER *miner, size_t *workSize, char *host, unsigned short port);
+
+#endif
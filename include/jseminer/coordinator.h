@@ -0,0 +1,78 @@
+/*
+MIT License
+
+Copyright (c) 2019 iagocq
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _JSEMINER_COORDINATOR_H_
+#define _JSEMINER_COORDINATOR_H_
+
+#include <jseminer/job.h>
+#include <jseminer/netbuffer.h>
+#include <jseminer/socket.h>
+
+#define COORDINATOR_MAX_WORKERS 64
+#define COORDINATOR_MAX_RECLAIMED 256
+// One lease being mined and one queued behind it, so workers never wait for the next range
+#define COORDINATOR_LEASES_PER_WORKER 2
+// Leases are sized to last about this long at the worker's reported hashrate
+#define COORDINATOR_LEASE_SECONDS 5
+// A lease is reassigned once it is outstanding this many times longer than expected
+#define COORDINATOR_LEASE_TIMEOUT 3
+#define COORDINATOR_MIN_LEASE (1 << 20)
+#define COORDINATOR_POLL_INTERVAL 500
+
+typedef struct LEASE {
+    uint32_t id;
+    uint64_t start, count;
+    uint64_t expires;
+    int active;
+} LEASE;
+
+typedef struct WORKER {
+    LSOCKET sock;
+    NET_BUFFER in, out;
+    int active;
+    uint64_t hashrate;
+    LEASE leases[COORDINATOR_LEASES_PER_WORKER];
+} WORKER;
+
+typedef struct NONCE_RANGE {
+    uint64_t start, count;
+} NONCE_RANGE;
+
+typedef struct COORDINATOR {
+    LSOCKET listener, workerListener, upstream;
+    // Every socket is non-blocking, so one slow peer never holds up the others
+    NET_BUFFER upstreamIn, upstreamOut;
+    int hasUpstream, hasJob;
+    JOB job;
+    uint64_t nextNonce;
+    uint32_t nextLeaseId;
+    uint32_t generation;
+    WORKER workers[COORDINATOR_MAX_WORKERS];
+    NONCE_RANGE reclaimed[COORDINATOR_MAX_RECLAIMED];
+    int reclaimedCount;
+} COORDINATOR;
+
+int runCoordinator(char *bindIP, unsigned short bindPort, unsigned short workerPort);
+
+#endif
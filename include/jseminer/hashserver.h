@@ -0,0 +1,49 @@
+/*
+MIT License
+
+Copyright (c) 2019 iagocq
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _JSEMINER_HASHSERVER_H_
+#define _JSEMINER_HASHSERVER_H_
+
+#include <jseminer/miner.h>
+#include <jseminer/socket.h>
+
+// Wire layout: prehash (64), start nonce (8), nonce count (8), digest bytes (1), big-endian
+#define HASHSERVER_REQUEST_SIZE 81
+// One buffer is streamed to the client while the device fills the other
+#define HASHSERVER_BUFFERS 2
+
+typedef struct HASH_SERVER {
+    CL_MINER *miner;
+    cl_kernel kernel;
+    uint32_t jobData[8];
+    cl_mem jobBuffer;
+    cl_mem digestBuffers[HASHSERVER_BUFFERS];
+    cl_event done[HASHSERVER_BUFFERS];
+    size_t workSize[3];
+    uint32_t nitems;
+} HASH_SERVER;
+
+int runHashServer(CL_MINER *miner, size_t *workSize, char *bindIP, unsigned short bindPort);
+
+#endif
@@ -0,0 +1,92 @@
+/*
+MIT License
+
+Copyright (c) 2019 iagocq
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _JSEMINER_JOB_H_
+#define _JSEMINER_JOB_H_
+
+#include <inttypes.h>
+#include <jseminer/socket.h>
+
+// Wire layout: difficulty mask (4), start nonce (8), prehash (64), all big-endian
+#define JOB_PACKET_SIZE 76
+// A difficulty mask of 0 marks an extended job, followed by flags (4) and a big-endian 256-bit target (32)
+#define JOB_EXTENSION_SIZE 36
+#define JOB_PACKET_MAX_SIZE (JOB_PACKET_SIZE + JOB_EXTENSION_SIZE)
+// Wire layout: prehash (64), nonce (8)
+#define SHARE_PACKET_SIZE 72
+// Wire layout: share packet, weight (4)
+#define WEIGHTED_SHARE_PACKET_SIZE 76
+// Wire layout: lease ID (4), job generation (4), nonce count (8), job packet
+#define LEASE_HEADER_SIZE 16
+#define LEASE_PACKET_MAX_SIZE (LEASE_HEADER_SIZE + JOB_PACKET_MAX_SIZE)
+
+#define JOB_QUEUE_SIZE 16
+
+// Opts the job in to share rate adaptation, its shares are then sent as weighted share packets
+#define JOB_FLAG_ADAPT 0x1
+
+typedef struct JOB {
+    uint32_t difficultyMask;
+    uint64_t startNonce;
+    // A nonce count of 0 means the job has no end; leased jobs stop after nonceCount nonces
+    uint64_t nonceCount;
+    uint32_t leaseId;
+    // Bumped by the coordinator for every job it receives, leases of an older generation are stale
+    uint32_t generation;
+    uint32_t flags;
+    // A hash is a share when its first word passes difficultyMask and the whole digest is at most target
+    uint32_t target[8];
+    char prehash[64];
+} JOB;
+
+typedef struct SHARE {
+    char prehash[64];
+    uint64_t nonce;
+    // Only set in client mode, for shares found in a lease; not part of the share packet
+    uint32_t leaseId;
+} SHARE;
+
+typedef struct JOB_QUEUE {
+    JOB jobs[JOB_QUEUE_SIZE];
+    int head, count;
+} JOB_QUEUE;
+
+void jobMidstate(JOB *job, uint32_t *hashedPrehash);
+void jobDecode(char *buf, JOB *job);
+void jobDecodeExtension(char *buf, JOB *job);
+int jobEncode(JOB *job, char *buf);
+int jobRecv(LSOCKET *sock, char *buf, JOB *job);
+int jobParse(char *buf, int length, JOB *job);
+int leaseParse(char *buf, int length, JOB *job);
+int leaseEncode(JOB *job, char *buf);
+void shareDecode(char *buf, SHARE *share);
+void shareEncode(SHARE *share, char *buf);
+void weightedShareEncode(SHARE *share, uint32_t weight, char *buf);
+void jobQueueInit(JOB_QUEUE *queue);
+int jobQueuePush(JOB_QUEUE *queue, JOB *job);
+int jobQueuePop(JOB_QUEUE *queue, JOB *job);
+JOB *jobQueuePeek(JOB_QUEUE *queue);
+void jobQueueDropStale(JOB_QUEUE *queue, uint32_t generation);
+
+#endif
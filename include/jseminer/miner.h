@@ -25,20 +25,27 @@ SOFTWARE.
 #ifndef _JSEMINER_MINER_H_
 #define _JSEMINER_MINER_H_
 
-#define CL_TARGET_OPENCL_VERSION 120
+#define CL_TARGET_OPENCL_VERSION 200
+#define CL_USE_DEPRECATED_OPENCL_1_2_APIS
 
 #include <CL/cl.h>
+#include <jseminer/job.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+// Jobs are written into the next of these buffers, so a job switch never waits for or reallocates a buffer
+#define MINER_JOB_SLOTS 4
+
 #define checkError(error) _checkError(__LINE__, error)
 
-#define fCheckError(error) _fCheckError(__LINE__, error)
-#define _fCheckError(line, error)                                                                            \
+#define fCheckError(error) _rCheckError(__LINE__, error, 0)
+// Same as fCheckError for functions that return something other than 0 on OpenCL errors
+#define rCheckError(error, value) _rCheckError(__LINE__, error, value)
+#define _rCheckError(line, error, value)                                                                     \
     do {                                                                                                     \
         if (error != CL_SUCCESS) {                                                                           \
             fprintf(stderr, "%d: OpenCL call failed with error code %d\n", line, error);                     \
-            return 0;                                                                                        \
+            return value;                                                                                    \
         }                                                                                                    \
     } while (0)
 
@@ -50,6 +57,15 @@ typedef struct _CL_MINER {
     cl_program program;
     cl_kernel kernel;
     cl_command_queue commandQueue;
+    // Midstate and target of each job slot, kept until the non-blocking write of the slot completes
+    cl_uint jobData[MINER_JOB_SLOTS][16];
+    cl_mem jobBuffers[MINER_JOB_SLOTS];
+    cl_event jobWritten[MINER_JOB_SLOTS];
+    int jobSlot;
+    cl_mem resultBuffer;
+    uint8_t *hostResult;
+    // Set when the device shares memory with the host, so buffers are mapped instead of copied
+    int unifiedMemory;
     size_t maxWorkDimensions[3];
 } CL_MINER;
 
@@ -57,10 +73,16 @@ void _checkError(int line, cl_int error);
 char *getPlatformName(cl_platform_id platformId);
 char *getDeviceName(cl_device_id deviceId);
 cl_program createProgram(char *source, size_t len, cl_context context, cl_int *error);
-int setupMiner(CL_MINER *miner, cl_platform_id platform, cl_device_id device, char *source, char *kernel);
+int setupMiner(CL_MINER *miner, cl_platform_id platform, cl_device_id device, char *source, char *kernel,
+               char *options);
 int getPlatforms(CL_MINER *miner);
 int getDevices(CL_MINER *miner, cl_platform_id platform, cl_device_type deviceType);
 int getMaxWorkDimensions(CL_MINER *miner, cl_device_id device);
+cl_mem createMappableBuffer(CL_MINER *miner, cl_mem_flags flags, size_t size, cl_int *error);
+int createMinerBuffers(CL_MINER *miner, size_t nitems);
+int setMinerJob(CL_MINER *miner, JOB *job);
+int doMineRound(CL_MINER *miner, size_t *workSize, uint8_t **result);
+int endMineRound(CL_MINER *miner, uint8_t *result);
 void releaseMiner(CL_MINER *miner);
 void initMiner(CL_MINER *miner);
 
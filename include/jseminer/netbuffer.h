@@ -0,0 +1,45 @@
+/*
+MIT License
+
+Copyright (c) 2019 iagocq
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _JSEMINER_NETBUFFER_H_
+#define _JSEMINER_NETBUFFER_H_
+
+#include <jseminer/socket.h>
+
+// Holds every share a client may have unacknowledged, with room to spare
+#define NET_BUFFER_SIZE 32768
+
+// Bytes read from or waiting to be written to a non-blocking socket, so a slow peer never stalls the caller
+typedef struct NET_BUFFER {
+    char data[NET_BUFFER_SIZE];
+    int length;
+} NET_BUFFER;
+
+void netBufferInit(NET_BUFFER *buffer);
+int netBufferFill(NET_BUFFER *buffer, LSOCKET *sock);
+void netBufferConsume(NET_BUFFER *buffer, int count);
+int netBufferQueue(NET_BUFFER *buffer, char *data, int length);
+int netBufferFlush(NET_BUFFER *buffer, LSOCKET *sock);
+
+#endif
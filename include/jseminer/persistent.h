@@ -0,0 +1,101 @@
+/*
+MIT License
+
+Copyright (c) 2019 iagocq
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _JSEMINER_PERSISTENT_H_
+#define _JSEMINER_PERSISTENT_H_
+
+#include <jseminer/job.h>
+#include <jseminer/miner.h>
+
+#define PERSISTENT_RING_SIZE 4096
+// Nonces a work item hashes between two looks at the current job
+#define PERSISTENT_CHUNK_SIZE 256
+// The work word holds the job epoch above this bit and the next nonce chunk below it
+#define PERSISTENT_EPOCH_SHIFT 48
+#define PERSISTENT_EPOCH_MASK 0xFFFF
+#define PERSISTENT_CHUNK_MASK ((1ULL << PERSISTENT_EPOCH_SHIFT) - 1)
+// Claimed chunks after which the host moves the job's start nonce forward, long before the chunk count could
+// carry into the epoch
+#define PERSISTENT_REBASE_CHUNKS (1ULL << 32)
+
+#define _PERSISTENT_STR(x) #x
+#define PERSISTENT_STR(x) _PERSISTENT_STR(x)
+#define PERSISTENT_BUILD_OPTIONS                                                                             \
+    "-cl-std=CL2.0 -DPERSISTENT_RING_SIZE=" PERSISTENT_STR(PERSISTENT_RING_SIZE)                             \
+    " -DPERSISTENT_EPOCH_SHIFT=" PERSISTENT_STR(PERSISTENT_EPOCH_SHIFT)
+
+#ifdef CL_VERSION_2_0
+#include <stdatomic.h>
+
+// Layouts must match the persistent_* structs in sha256.cl
+typedef struct PERSISTENT_JOB {
+    cl_uint difficultyMask;
+    cl_uint reserved;
+    cl_ulong startNonce;
+    cl_uint hashedPrehash[8];
+    cl_uint target[8];
+} PERSISTENT_JOB;
+
+typedef struct PERSISTENT_SHARE {
+    cl_ulong nonce;
+    cl_uint epoch;
+    _Atomic cl_uint ready;
+} PERSISTENT_SHARE;
+
+typedef struct PERSISTENT_STATE {
+    // Job epoch in the high 16 bits, next nonce chunk in the low 48 bits
+    _Atomic cl_ulong work;
+    _Atomic cl_uint stop;
+    _Atomic cl_uint shareHead;
+    _Atomic cl_uint shareTail;
+    _Atomic cl_uint dropped;
+    // Indexed by epoch & 1, so the slot being rewritten is never the one in use
+    PERSISTENT_JOB jobs[2];
+    PERSISTENT_SHARE shares[PERSISTENT_RING_SIZE];
+} PERSISTENT_STATE;
+#else
+typedef struct PERSISTENT_STATE PERSISTENT_STATE;
+#endif
+
+typedef struct PERSISTENT_MINER {
+    CL_MINER *miner;
+    cl_kernel kernel;
+    PERSISTENT_STATE *state;
+    size_t workSize[3];
+    cl_uint epoch;
+    cl_uint dropped;
+    int running;
+    // Set when the last switch only moved the start nonce, so shares of the previous epoch are still good
+    int rebased;
+    JOB jobs[2];
+} PERSISTENT_MINER;
+
+int isPersistentSupported(cl_device_id device);
+int setupPersistent(PERSISTENT_MINER *pminer, CL_MINER *miner, size_t *workSize);
+int setPersistentJob(PERSISTENT_MINER *pminer, JOB *job);
+int pollPersistentShares(PERSISTENT_MINER *pminer, SHARE *shares, int maxShares);
+void stopPersistent(PERSISTENT_MINER *pminer);
+void releasePersistent(PERSISTENT_MINER *pminer);
+
+#endif
@@ -35,7 +35,9 @@ SOFTWARE.
 #undef UNICODE
 #else // _WIN32
 #include <arpa/inet.h>
+#include <fcntl.h>
 #include <netdb.h>
+#include <sys/select.h>
 #include <sys/socket.h>
 #include <unistd.h>
 #define SOCKET_LIB
@@ -57,8 +59,15 @@ int socketInit(void);
 int socketDeInit(void);
 int socketCreate(LSOCKET *sock, int ver, int type);
 int socketClose(LSOCKET *sock);
+int socketConnect(LSOCKET *sock, char *host, unsigned short port);
+int socketConnectResult(LSOCKET *sock);
+int socketWouldBlock(void);
+int socketSetBlocking(LSOCKET *sock, int blocking);
+int socketWaitReadable(LSOCKET *sock, long timeoutMs);
 int socketSend(LSOCKET *sock, char *message, int);
+int socketSendAll(LSOCKET *sock, char *message, int len);
 int socketRecv(LSOCKET *sock, char *buf, int len);
+int socketRecvAll(LSOCKET *sock, char *buf, int len);
 int socketBind(LSOCKET *sock, char *address, unsigned short port);
 int socketListen(LSOCKET *sock, int backlog);
 int socketAccept(LSOCKET *sock, LSOCKET *client);
@@ -0,0 +1,110 @@
+/*
+MIT License
+
+Copyright (c) 2019 iagocq
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <jseminer/adapt.h>
+#include <jseminer/timer.h>
+
+void adapterInit(SHARE_ADAPTER *adapter, double sharesPerSecond) {
+    adapter->sharesPerSecond = sharesPerSecond;
+    adapter->shift = 0;
+    adapter->windowStart = timerMillis();
+    adapter->windowShares = 0;
+}
+
+// How many times ratio can be halved before it drops below 2, capped at what a shift can take
+static int halvings(double ratio) {
+    int n = 0;
+
+    while (ratio >= 2 && n < ADAPT_MAX_SHIFT) {
+        ratio /= 2;
+        n++;
+    }
+    return n;
+}
+
+static void adapterShift(SHARE_ADAPTER *adapter, int steps) {
+    int shift = (int) adapter->shift + steps;
+
+    if (shift < 0)
+        shift = 0;
+    if (shift > ADAPT_MAX_SHIFT)
+        shift = ADAPT_MAX_SHIFT;
+    adapter->shift = (unsigned int) shift;
+}
+
+// Counts the shares of a round, returns 1 when the shift changed and the mined job has to be rebuilt
+int adapterUpdate(SHARE_ADAPTER *adapter, uint64_t shares) {
+    uint64_t now = timerMillis();
+    uint64_t elapsed = now - adapter->windowStart;
+    double expected = adapter->sharesPerSecond * ADAPT_WINDOW / 1000;
+    unsigned int shift = adapter->shift;
+    double rate;
+
+    adapter->windowShares += shares;
+    if (elapsed < ADAPT_WINDOW && adapter->windowShares <= expected * ADAPT_BURST)
+        return 0;
+
+    rate = adapter->windowShares * 1000.0 / (elapsed > 0 ? elapsed : 1);
+    if (rate > adapter->sharesPerSecond * 2) {
+        adapterShift(adapter, halvings(rate / adapter->sharesPerSecond));
+    } else if (rate < adapter->sharesPerSecond / 2) {
+        // An empty window says nothing about how far off we are, so only ease one step at a time
+        adapterShift(adapter, adapter->windowShares == 0 ? -1 : -halvings(adapter->sharesPerSecond / rate));
+    }
+
+    adapter->windowStart = now;
+    adapter->windowShares = 0;
+    return adapter->shift != shift;
+}
+
+// Builds the job to mine, whose shares are a subset of the shares of job that are 2^shift times rarer.
+// Returns the shift that was applied, which falls short of the one asked for when the mask runs out of bits.
+unsigned int adaptJob(JOB *job, unsigned int shift, JOB *mined) {
+    unsigned int applied = 0;
+
+    *mined = *job;
+    if (shift == 0)
+        return 0;
+
+    // Every bit the mask does not cover yet halves the shares exactly, the free bits are taken from the top
+    if (job->difficultyMask != 0) {
+        for (int bit = 31; bit >= 0 && applied < shift; bit--) {
+            if (!(job->difficultyMask & (1u << bit))) {
+                mined->difficultyMask |= 1u << bit;
+                applied++;
+            }
+        }
+        return applied;
+    }
+
+    // 256-bit right shift, word 0 is the most significant
+    for (int i = 7; i >= 0; i--) {
+        int from = i - (int) (shift / 32);
+        uint64_t bits = from >= 0 ? (uint64_t) job->target[from] : 0;
+        if (from > 0)
+            bits |= (uint64_t) job->target[from - 1] << 32;
+        mined->target[i] = (uint32_t) (bits >> (shift % 32));
+    }
+    return shift;
+}
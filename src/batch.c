@@ -0,0 +1,258 @@
+/*
+MIT License
+
+Copyright (c) 2019 iagocq
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <jseminer/batch.h>
+
+#include <string.h>
+
+// Lines are "<difficulty> <start nonce> <prehash>", where difficulty is a hex mask or a 64 digit hex target
+static int parseJob(char *line, JOB *job) {
+    char difficulty[66], prehash[66];
+    unsigned long long startNonce;
+    size_t digits;
+    char *end;
+
+    if (sscanf(line, "%65s %llu %65s", difficulty, &startNonce, prehash) != 3 || strlen(prehash) != 64)
+        return 0;
+    // Either a mask that fits a word or a full target, anything in between would be cut short by strtoul
+    digits = strlen(difficulty);
+    if (strspn(difficulty, "0123456789abcdefABCDEF") != digits || (digits > 8 && digits != 64))
+        return 0;
+
+    memset(job, 0, sizeof(*job));
+    job->startNonce = startNonce;
+    memcpy(job->prehash, prehash, 64);
+    memset(job->target, 0xFF, sizeof(job->target));
+
+    if (digits == 64) {
+        for (int i = 0; i < 8; i++) {
+            char word[9];
+            memcpy(word, &difficulty[i * 8], 8);
+            word[8] = '\0';
+            job->target[i] = (uint32_t) strtoul(word, &end, 16);
+            if (*end != '\0')
+                return 0;
+        }
+    } else {
+        job->difficultyMask = (uint32_t) strtoul(difficulty, &end, 16);
+        if (*end != '\0')
+            return 0;
+    }
+    return 1;
+}
+
+static int readJob(FILE *input, uint64_t *lineNumber, JOB *job) {
+    char line[BATCH_LINE_SIZE];
+
+    while (fgets(line, sizeof(line), input) != NULL) {
+        size_t len = strlen(line);
+        (*lineNumber)++;
+
+        if (len == sizeof(line) - 1 && line[len - 1] != '\n') {
+            int c;
+            while ((c = fgetc(input)) != EOF && c != '\n')
+                ;
+            fprintf(stderr, "Line %" PRIu64 " is too long, skipping\n", *lineNumber);
+            continue;
+        }
+        if (strspn(line, " \t\r\n") == len)
+            continue;
+        if (parseJob(line, job))
+            return 1;
+        fprintf(stderr, "Line %" PRIu64 " is not a valid job, skipping\n", *lineNumber);
+    }
+    return 0;
+}
+
+static int enqueueRound(CL_MINER *miner, size_t *workSize, BATCH_SLOT *slot) {
+    cl_int error;
+    size_t nitems = workSize[0] * workSize[1] * workSize[2];
+
+    error = clSetKernelArg(miner->kernel, 0, sizeof(cl_mem), &slot->jobBuffer);
+    fCheckError(error);
+    error = clSetKernelArg(miner->kernel, 1, sizeof(cl_mem), &slot->resultBuffer);
+    fCheckError(error);
+    error = clSetKernelArg(miner->kernel, 2, sizeof(cl_ulong), &slot->nonce);
+    fCheckError(error);
+    error = clSetKernelArg(miner->kernel, 3, sizeof(cl_uint), &slot->job.difficultyMask);
+    fCheckError(error);
+
+    error = clEnqueueNDRangeKernel(slot->queue, miner->kernel, 3, NULL, workSize, NULL, 0, NULL, NULL);
+    fCheckError(error);
+    if (miner->unifiedMemory) {
+        slot->result = (uint8_t *) clEnqueueMapBuffer(slot->queue, slot->resultBuffer, CL_FALSE, CL_MAP_READ,
+                                                      0, nitems, 0, NULL, &slot->readDone, &error);
+    } else {
+        slot->result = slot->hostResult;
+        error = clEnqueueReadBuffer(slot->queue, slot->resultBuffer, CL_FALSE, 0, nitems, slot->result, 0,
+                                    NULL, &slot->readDone);
+    }
+    fCheckError(error);
+    error = clFlush(slot->queue);
+    fCheckError(error);
+
+    return 1;
+}
+
+static int startJob(CL_MINER *miner, size_t *workSize, BATCH_SLOT *slot) {
+    cl_int error;
+
+    jobMidstate(&slot->job, slot->jobData);
+    memcpy(&slot->jobData[8], slot->job.target, sizeof(slot->job.target));
+    // The in-order queue finishes this write before the round that reads it
+    error = clEnqueueWriteBuffer(slot->queue, slot->jobBuffer, CL_FALSE, 0, sizeof(slot->jobData),
+                                 slot->jobData, 0, NULL, NULL);
+    fCheckError(error);
+
+    slot->nonce = slot->job.startNonce;
+    slot->shareCount = 0;
+    slot->active = 1;
+    return enqueueRound(miner, workSize, slot);
+}
+
+static int waitRound(BATCH_SLOT *slot) {
+    cl_int error = clWaitForEvents(1, &slot->readDone);
+
+    clReleaseEvent(slot->readDone);
+    fCheckError(error);
+    return 1;
+}
+
+static int endRound(CL_MINER *miner, BATCH_SLOT *slot) {
+    cl_int error;
+
+    if (!miner->unifiedMemory)
+        return 1;
+    error = clEnqueueUnmapMemObject(slot->queue, slot->resultBuffer, slot->result, 0, NULL, NULL);
+    fCheckError(error);
+    slot->result = NULL;
+    return 1;
+}
+
+static void printResult(BATCH_SLOT *slot) {
+    printf("%" PRIu64 " %.64s", slot->line, slot->job.prehash);
+    for (int i = 0; i < slot->shareCount; i++)
+        printf(" %" PRIu64, slot->shares[i]);
+    printf("\n");
+    fflush(stdout);
+}
+
+int runBatch(CL_MINER *miner, size_t *workSize, FILE *input, int sharesPerJob) {
+    cl_int error;
+    size_t nitems = workSize[0] * workSize[1] * workSize[2];
+    int slotCount = miner->deviceCount * BATCH_JOBS_PER_DEVICE;
+    BATCH_SLOT *slots = (BATCH_SLOT *) calloc(slotCount, sizeof(BATCH_SLOT));
+    cl_command_queue *queues = (cl_command_queue *) calloc(miner->deviceCount, sizeof(cl_command_queue));
+    uint64_t lineNumber = 0;
+    int inputDone = 0;
+    int active = 0;
+    int status = 1;
+
+    // Every device of the platform gets jobs, the first one reuses the miner's queue
+    queues[0] = miner->commandQueue;
+    for (cl_uint i = 1; i < miner->deviceCount; i++) {
+        queues[i] = clCreateCommandQueue(miner->context, miner->devices[i], 0, &error);
+        checkError(error);
+    }
+
+    for (int i = 0; i < slotCount; i++) {
+        BATCH_SLOT *slot = &slots[i];
+        slot->queue = queues[i % miner->deviceCount];
+        slot->jobBuffer =
+            clCreateBuffer(miner->context, CL_MEM_READ_ONLY, sizeof(slot->jobData), NULL, &error);
+        checkError(error);
+        slot->resultBuffer = createMappableBuffer(miner, CL_MEM_WRITE_ONLY, nitems, &error);
+        checkError(error);
+        if (!miner->unifiedMemory)
+            slot->hostResult = (uint8_t *) malloc(nitems);
+        slot->shares = (uint64_t *) malloc(sharesPerJob * sizeof(uint64_t));
+    }
+
+    for (int i = 0; i < slotCount && !inputDone; i++) {
+        if (readJob(input, &lineNumber, &slots[i].job)) {
+            slots[i].line = lineNumber;
+            if (!startJob(miner, workSize, &slots[i])) {
+                status = 0;
+                break;
+            }
+            active++;
+        } else {
+            inputDone = 1;
+        }
+    }
+
+    while (active > 0 && status) {
+        for (int i = 0; i < slotCount && status; i++) {
+            BATCH_SLOT *slot = &slots[i];
+            if (!slot->active)
+                continue;
+
+            if (!waitRound(slot)) {
+                status = 0;
+                break;
+            }
+
+            for (size_t j = 0; j < nitems && slot->shareCount < sharesPerJob; j++) {
+                if (slot->result[j] == 1)
+                    slot->shares[slot->shareCount++] = slot->nonce + j;
+            }
+            if (!endRound(miner, slot)) {
+                status = 0;
+                break;
+            }
+
+            if (slot->shareCount < sharesPerJob) {
+                slot->nonce += nitems;
+                status = enqueueRound(miner, workSize, slot);
+                continue;
+            }
+
+            printResult(slot);
+            slot->active = 0;
+            active--;
+            if (!inputDone && readJob(input, &lineNumber, &slot->job)) {
+                slot->line = lineNumber;
+                status = startJob(miner, workSize, slot);
+                active++;
+            } else {
+                inputDone = 1;
+            }
+        }
+    }
+
+    for (cl_uint i = 0; i < miner->deviceCount; i++)
+        clFinish(queues[i]);
+    for (int i = 0; i < slotCount; i++) {
+        clReleaseMemObject(slots[i].jobBuffer);
+        clReleaseMemObject(slots[i].resultBuffer);
+        free(slots[i].hostResult);
+        free(slots[i].shares);
+    }
+    for (cl_uint i = 1; i < miner->deviceCount; i++)
+        clReleaseCommandQueue(queues[i]);
+    free(queues);
+    free(slots);
+
+    return status;
+}
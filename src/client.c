@@ -0,0 +1,302 @@
+/*
+MIT License
+
+Copyright (c) 2019 iagocq
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <jseminer/client.h>
+#include <jseminer/timer.h>
+
+#include <string.h>
+
+static void clientDisconnect(POOL_CLIENT *client) {
+    if (client->state != CLIENT_DISCONNECTED)
+        socketClose(&client->sock);
+    client->state = CLIENT_DISCONNECTED;
+    client->nextAttempt = timerMillis() + client->backoff;
+    fprintf(stderr, "Disconnected from pool, retrying in %" PRIu64 " ms\n", client->backoff);
+
+    client->backoff *= 2;
+    if (client->backoff > CLIENT_BACKOFF_MAX)
+        client->backoff = CLIENT_BACKOFF_MAX;
+}
+
+// A pool that lets this much pile up without reading is treated as gone, unacknowledged shares survive that
+static int clientQueue(POOL_CLIENT *client, char *message, int length) {
+    if (!netBufferQueue(&client->out, message, length)) {
+        fprintf(stderr, "Pool is not reading, reconnecting\n");
+        clientDisconnect(client);
+        return 0;
+    }
+    return 1;
+}
+
+// Shares of a lease carry its ID, so the coordinator can tell them from shares of leases it took back
+static int clientSendShare(POOL_CLIENT *client, SHARE *share) {
+    char netBuf[1 + LEASE_SHARE_PACKET_SIZE];
+    uint32_t leaseId = htonl(share->leaseId);
+
+    if (share->leaseId == 0) {
+        netBuf[0] = CLIENT_MSG_SHARE;
+        shareEncode(share, &netBuf[1]);
+        return clientQueue(client, netBuf, 1 + SHARE_PACKET_SIZE);
+    }
+
+    netBuf[0] = CLIENT_MSG_LEASE_SHARE;
+    memcpy(&netBuf[1], &leaseId, 4);
+    shareEncode(share, &netBuf[5]);
+    return clientQueue(client, netBuf, sizeof(netBuf));
+}
+
+static void clientAcknowledge(POOL_CLIENT *client, SHARE *share) {
+    for (int i = 0; i < client->pendingCount; i++) {
+        SHARE *pending = &client->pending[i];
+        if (pending->nonce == share->nonce && !memcmp(pending->prehash, share->prehash, 64)) {
+            client->pendingCount--;
+            memmove(&client->pending[i], &client->pending[i + 1], (client->pendingCount - i) * sizeof(SHARE));
+            return;
+        }
+    }
+}
+
+static void clientConnected(POOL_CLIENT *client) {
+    netBufferInit(&client->in);
+    netBufferInit(&client->out);
+    client->state = CLIENT_CONNECTED;
+    client->backoff = CLIENT_BACKOFF_MIN;
+    printf("Connected to pool %s:%hu\n", client->host, client->port);
+
+    if (client->pendingCount > 0)
+        printf("Resubmitting %d unacknowledged shares\n", client->pendingCount);
+    for (int i = 0; i < client->pendingCount && client->state == CLIENT_CONNECTED; i++)
+        clientSendShare(client, &client->pending[i]);
+}
+
+static void clientStartConnect(POOL_CLIENT *client) {
+    if (!socketCreate(&client->sock, AF_INET, SOCK_STREAM)) {
+        zerror("socketCreate Error");
+        clientDisconnect(client);
+        return;
+    }
+    socketSetBlocking(&client->sock, 0);
+    client->state = CLIENT_CONNECTING;
+    client->connectDeadline = timerMillis() + CLIENT_CONNECT_TIMEOUT;
+
+    if (socketConnect(&client->sock, client->host, client->port) == 0)
+        clientConnected(client);
+    else if (!socketWouldBlock())
+        clientDisconnect(client);
+}
+
+static void clientRead(POOL_CLIENT *client) {
+    NET_BUFFER *in = &client->in;
+    JOB job;
+    SHARE share;
+
+    if (!netBufferFill(in, &client->sock)) {
+        clientDisconnect(client);
+        return;
+    }
+
+    // Only whole messages are decoded, a partial one waits in the buffer for the next poll
+    while (in->length > 0) {
+        char *payload = &in->data[1];
+        int length = in->length - 1;
+        int used = 0;
+
+        switch (in->data[0]) {
+        case CLIENT_MSG_JOB:
+            if ((used = jobParse(payload, length, &job)) > 0 && !jobQueuePush(&client->jobs, &job))
+                fprintf(stderr, "Job queue full, dropped the oldest job\n");
+            break;
+        case CLIENT_MSG_LEASE:
+            if ((used = leaseParse(payload, length, &job)) == 0)
+                break;
+            // Leases for an older job are worthless once the coordinator moves on, even for the same prehash
+            jobQueueDropStale(&client->jobs, job.generation);
+            if (!jobQueuePush(&client->jobs, &job))
+                fprintf(stderr, "Job queue full, dropped the oldest job\n");
+            break;
+        case CLIENT_MSG_ACK:
+            if (length < SHARE_PACKET_SIZE)
+                break;
+            used = SHARE_PACKET_SIZE;
+            shareDecode(payload, &share);
+            clientAcknowledge(client, &share);
+            break;
+        default:
+            fprintf(stderr, "Unknown message type 0x%02x from pool\n", (unsigned char) in->data[0]);
+            clientDisconnect(client);
+            return;
+        }
+
+        if (used == 0)
+            return;
+        netBufferConsume(in, 1 + used);
+    }
+}
+
+void clientInit(POOL_CLIENT *client, char *host, unsigned short port) {
+    memset(client, 0, sizeof(*client));
+    client->host = host;
+    client->port = port;
+    client->state = CLIENT_DISCONNECTED;
+    client->backoff = CLIENT_BACKOFF_MIN;
+    client->nextAttempt = 0;
+    jobQueueInit(&client->jobs);
+}
+
+void clientPoll(POOL_CLIENT *client) {
+    int result;
+
+    switch (client->state) {
+    case CLIENT_DISCONNECTED:
+        if (timerMillis() >= client->nextAttempt)
+            clientStartConnect(client);
+        break;
+    case CLIENT_CONNECTING:
+        result = socketConnectResult(&client->sock);
+        if (result == 1)
+            clientConnected(client);
+        else if (result < 0 || timerMillis() >= client->connectDeadline)
+            clientDisconnect(client);
+        break;
+    }
+
+    if (client->state == CLIENT_CONNECTED && !netBufferFlush(&client->out, &client->sock))
+        clientDisconnect(client);
+    if (client->state == CLIENT_CONNECTED)
+        clientRead(client);
+}
+
+void clientSubmitShare(POOL_CLIENT *client, SHARE *share) {
+    if (client->pendingCount == CLIENT_MAX_PENDING) {
+        fprintf(stderr, "Too many unacknowledged shares, dropping the oldest\n");
+        client->pendingCount--;
+        memmove(&client->pending[0], &client->pending[1], client->pendingCount * sizeof(SHARE));
+    }
+    client->pending[client->pendingCount++] = *share;
+
+    if (client->state == CLIENT_CONNECTED)
+        clientSendShare(client, share);
+}
+
+void clientReportLease(POOL_CLIENT *client, uint32_t leaseId, uint64_t hashrate) {
+    char netBuf[1 + LEASE_DONE_PACKET_SIZE];
+    uint32_t id = htonl(leaseId);
+    uint64_t rate = htonll(hashrate);
+
+    // Not worth resending: the coordinator reclaims the leases of a worker that goes away
+    if (client->state != CLIENT_CONNECTED)
+        return;
+
+    netBuf[0] = CLIENT_MSG_DONE;
+    memcpy(&netBuf[1], &id, 4);
+    memcpy(&netBuf[5], &rate, 8);
+    clientQueue(client, netBuf, sizeof(netBuf));
+}
+
+void clientClose(POOL_CLIENT *client) {
+    if (client->state != CLIENT_DISCONNECTED)
+        socketClose(&client->sock);
+    client->state = CLIENT_DISCONNECTED;
+}
+
+// The current job only gives way early when it has no end or when the next one is for a newer job
+static int shouldSwitchJob(POOL_CLIENT *client, JOB *current, int hasJob) {
+    JOB *next = jobQueuePeek(&client->jobs);
+
+    if (next == NULL)
+        return 0;
+    return !hasJob || current->nonceCount == 0 || current->generation != next->generation;
+}
+
+int runClient(CL_MINER *miner, size_t *workSize, char *host, unsigned short port) {
+    POOL_CLIENT *client = (POOL_CLIENT *) malloc(sizeof(POOL_CLIENT));
+    uint32_t nitems = workSize[0] * workSize[1] * workSize[2];
+    uint8_t *roundResult;
+    JOB job;
+    SHARE share;
+    cl_ulong nonce = 0;
+    uint64_t endNonce = 0;
+    uint64_t jobStartTime = 0;
+    int hasJob = 0;
+    int status = 1;
+
+    clientInit(client, host, port);
+
+    while (status) {
+        clientPoll(client);
+
+        // Without a newer job we keep hashing the last valid one, even while the pool is unreachable
+        if (shouldSwitchJob(client, &job, hasJob)) {
+            jobQueuePop(&client->jobs, &job);
+            // Leases run one after the other, but a newer job replaces an unbounded one outright
+            while (job.nonceCount == 0 && jobQueuePeek(&client->jobs) != NULL)
+                jobQueuePop(&client->jobs, &job);
+            if (!setMinerJob(miner, &job)) {
+                status = 0;
+                break;
+            }
+            nonce = job.startNonce;
+            endNonce = job.startNonce + job.nonceCount;
+            jobStartTime = timerMillis();
+            hasJob = 1;
+        }
+
+        if (!hasJob) {
+            timerSleep(CLIENT_IDLE_SLEEP);
+            continue;
+        }
+
+        clSetKernelArg(miner->kernel, 2, sizeof(cl_ulong), &nonce);
+        if (!doMineRound(miner, workSize, &roundResult)) {
+            fprintf(stderr, "Mine error!\n");
+            status = 0;
+            break;
+        }
+        for (uint32_t i = 0; i < nitems; i++) {
+            if (roundResult[i] == 1) {
+                if (job.nonceCount != 0 && nonce + i >= endNonce)
+                    break;
+                memcpy(share.prehash, job.prehash, 64);
+                share.nonce = nonce + i;
+                share.leaseId = job.leaseId;
+                clientSubmitShare(client, &share);
+            }
+        }
+        if (!endMineRound(miner, roundResult)) {
+            status = 0;
+            break;
+        }
+        nonce += nitems;
+
+        if (job.nonceCount != 0 && nonce >= endNonce) {
+            uint64_t elapsed = timerMillis() - jobStartTime;
+            clientReportLease(client, job.leaseId, elapsed > 0 ? job.nonceCount * 1000 / elapsed : 0);
+            hasJob = 0;
+        }
+    }
+
+    clientClose(client);
+    free(client);
+    return status;
+}
@@ -0,0 +1,389 @@
+/*
+MIT License
+
+Copyright (c) 2019 iagocq
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <jseminer/client.h>
+#include <jseminer/coordinator.h>
+#include <jseminer/timer.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void reclaimLease(COORDINATOR *coord, LEASE *lease) {
+    if (!lease->active)
+        return;
+    lease->active = 0;
+
+    if (!coord->hasJob)
+        return;
+    if (coord->reclaimedCount == COORDINATOR_MAX_RECLAIMED) {
+        fprintf(stderr, "Too many reclaimed ranges, nonces %" PRIu64 "+%" PRIu64 " will not be searched\n",
+                lease->start, lease->count);
+        return;
+    }
+    coord->reclaimed[coord->reclaimedCount].start = lease->start;
+    coord->reclaimed[coord->reclaimedCount].count = lease->count;
+    coord->reclaimedCount++;
+}
+
+// Hands out reclaimed ranges first so that expired leases get searched before new ones
+static void allocateRange(COORDINATOR *coord, uint64_t size, LEASE *lease) {
+    if (coord->reclaimedCount > 0) {
+        NONCE_RANGE *range = &coord->reclaimed[coord->reclaimedCount - 1];
+        lease->start = range->start;
+        if (range->count > size) {
+            lease->count = size;
+            range->start += size;
+            range->count -= size;
+        } else {
+            lease->count = range->count;
+            coord->reclaimedCount--;
+        }
+        return;
+    }
+
+    lease->start = coord->nextNonce;
+    lease->count = size;
+    coord->nextNonce += size;
+}
+
+static void dropWorker(COORDINATOR *coord, WORKER *worker) {
+    for (int i = 0; i < COORDINATOR_LEASES_PER_WORKER; i++)
+        reclaimLease(coord, &worker->leases[i]);
+    socketClose(&worker->sock);
+    worker->active = 0;
+    printf("Worker %d disconnected\n", (int) (worker - coord->workers));
+}
+
+// Returns 0 and drops the worker when it lets a full buffer of messages pile up
+static int queueToWorker(COORDINATOR *coord, WORKER *worker, char *message, int length) {
+    if (netBufferQueue(&worker->out, message, length))
+        return 1;
+    fprintf(stderr, "Worker %d is not reading\n", (int) (worker - coord->workers));
+    dropWorker(coord, worker);
+    return 0;
+}
+
+static void fillLeases(COORDINATOR *coord, WORKER *worker) {
+    char netBuf[1 + LEASE_PACKET_MAX_SIZE];
+    uint64_t size = worker->hashrate * COORDINATOR_LEASE_SECONDS;
+    int held = 0;
+    JOB job;
+
+    if (!coord->hasJob)
+        return;
+    if (size < COORDINATOR_MIN_LEASE)
+        size = COORDINATOR_MIN_LEASE;
+
+    for (int i = 0; i < COORDINATOR_LEASES_PER_WORKER; i++)
+        held += worker->leases[i].active;
+
+    for (int i = 0; i < COORDINATOR_LEASES_PER_WORKER; i++) {
+        LEASE *lease = &worker->leases[i];
+        if (lease->active)
+            continue;
+
+        allocateRange(coord, size, lease);
+        // Lease IDs start at 1, 0 marks shares found outside a lease
+        lease->id = ++coord->nextLeaseId;
+        lease->active = 1;
+        // Queued leases only start once the ones ahead of them finish
+        lease->expires =
+            timerMillis() + (uint64_t) ++held * COORDINATOR_LEASE_SECONDS * COORDINATOR_LEASE_TIMEOUT * 1000;
+
+        job = coord->job;
+        job.leaseId = lease->id;
+        job.generation = coord->generation;
+        job.startNonce = lease->start;
+        job.nonceCount = lease->count;
+        netBuf[0] = CLIENT_MSG_LEASE;
+        if (!queueToWorker(coord, worker, netBuf, 1 + leaseEncode(&job, &netBuf[1])))
+            return;
+    }
+}
+
+static void startJob(COORDINATOR *coord, JOB *job) {
+    coord->job = *job;
+    coord->hasJob = 1;
+    coord->generation++;
+    coord->nextNonce = job->startNonce;
+    coord->reclaimedCount = 0;
+
+    for (int i = 0; i < COORDINATOR_MAX_WORKERS; i++) {
+        WORKER *worker = &coord->workers[i];
+        for (int j = 0; j < COORDINATOR_LEASES_PER_WORKER; j++)
+            worker->leases[j].active = 0;
+        if (worker->active)
+            fillLeases(coord, worker);
+    }
+}
+
+static void stopJob(COORDINATOR *coord) {
+    coord->hasJob = 0;
+    coord->reclaimedCount = 0;
+    for (int i = 0; i < COORDINATOR_MAX_WORKERS; i++)
+        for (int j = 0; j < COORDINATOR_LEASES_PER_WORKER; j++)
+            coord->workers[i].leases[j].active = 0;
+}
+
+static void acceptWorker(COORDINATOR *coord) {
+    WORKER *worker = NULL;
+    LSOCKET sock;
+
+    if (!socketAccept(&coord->workerListener, &sock)) {
+        zerror("Accept Error");
+        return;
+    }
+    for (int i = 0; i < COORDINATOR_MAX_WORKERS && worker == NULL; i++) {
+        if (!coord->workers[i].active)
+            worker = &coord->workers[i];
+    }
+    if (worker == NULL) {
+        fprintf(stderr, "Too many workers, refusing connection\n");
+        socketClose(&sock);
+        return;
+    }
+
+    memset(worker, 0, sizeof(*worker));
+    socketSetBlocking(&sock, 0);
+    worker->sock = sock;
+    worker->active = 1;
+    printf("Worker %d connected\n", (int) (worker - coord->workers));
+    fillLeases(coord, worker);
+}
+
+// Only shares of a lease the worker still holds are forwarded. Leases of older jobs are gone, and the ranges
+// of expired ones were handed to someone else, whose shares count instead
+static void handleShare(COORDINATOR *coord, WORKER *worker, char *packet) {
+    char netBuf[1 + SHARE_PACKET_SIZE];
+    uint32_t leaseId;
+    int current = 0;
+
+    memcpy(&leaseId, packet, 4);
+    leaseId = ntohl(leaseId);
+    for (int i = 0; i < COORDINATOR_LEASES_PER_WORKER; i++)
+        current |= worker->leases[i].active && worker->leases[i].id == leaseId;
+
+    if (current && coord->hasUpstream && !netBufferQueue(&coord->upstreamOut, &packet[4], SHARE_PACKET_SIZE))
+        fprintf(stderr, "Upstream is not reading, dropped a share of lease %u\n", leaseId);
+
+    // Stale shares are acknowledged too, there is nobody left to take them
+    netBuf[0] = CLIENT_MSG_ACK;
+    memcpy(&netBuf[1], &packet[4], SHARE_PACKET_SIZE);
+    queueToWorker(coord, worker, netBuf, sizeof(netBuf));
+}
+
+static void handleDone(COORDINATOR *coord, WORKER *worker, char *packet) {
+    uint32_t leaseId;
+    uint64_t hashrate;
+
+    memcpy(&leaseId, packet, 4);
+    memcpy(&hashrate, &packet[4], 8);
+    leaseId = ntohl(leaseId);
+    worker->hashrate = ntohll(hashrate);
+
+    for (int i = 0; i < COORDINATOR_LEASES_PER_WORKER; i++) {
+        if (worker->leases[i].active && worker->leases[i].id == leaseId)
+            worker->leases[i].active = 0;
+    }
+    fillLeases(coord, worker);
+}
+
+static void handleWorker(COORDINATOR *coord, WORKER *worker) {
+    NET_BUFFER *in = &worker->in;
+
+    if (!netBufferFill(in, &worker->sock)) {
+        dropWorker(coord, worker);
+        return;
+    }
+
+    // Only whole messages are handled, a partial one waits in the buffer until the rest arrives
+    while (worker->active && in->length > 0) {
+        int length = in->length - 1;
+        int used = 0;
+
+        switch (in->data[0]) {
+        case CLIENT_MSG_LEASE_SHARE:
+            if (length < LEASE_SHARE_PACKET_SIZE)
+                break;
+            used = LEASE_SHARE_PACKET_SIZE;
+            handleShare(coord, worker, &in->data[1]);
+            break;
+        case CLIENT_MSG_DONE:
+            if (length < LEASE_DONE_PACKET_SIZE)
+                break;
+            used = LEASE_DONE_PACKET_SIZE;
+            handleDone(coord, worker, &in->data[1]);
+            break;
+        default:
+            fprintf(stderr, "Unknown message type 0x%02x from worker %d\n", (unsigned char) in->data[0],
+                    (int) (worker - coord->workers));
+            dropWorker(coord, worker);
+            return;
+        }
+
+        if (used == 0)
+            return;
+        netBufferConsume(in, 1 + used);
+    }
+}
+
+static void dropUpstream(COORDINATOR *coord) {
+    fprintf(stderr, "Closed connection\n");
+    socketClose(&coord->upstream);
+    coord->hasUpstream = 0;
+    stopJob(coord);
+}
+
+static void handleUpstream(COORDINATOR *coord) {
+    NET_BUFFER *in = &coord->upstreamIn;
+    JOB job;
+    int used;
+
+    if (!netBufferFill(in, &coord->upstream)) {
+        dropUpstream(coord);
+        return;
+    }
+
+    while ((used = jobParse(in->data, in->length, &job)) > 0) {
+        startJob(coord, &job);
+        netBufferConsume(in, used);
+    }
+}
+
+static void flushAll(COORDINATOR *coord) {
+    if (coord->hasUpstream && coord->upstreamOut.length > 0 &&
+        !netBufferFlush(&coord->upstreamOut, &coord->upstream))
+        dropUpstream(coord);
+
+    for (int i = 0; i < COORDINATOR_MAX_WORKERS; i++) {
+        WORKER *worker = &coord->workers[i];
+        if (worker->active && worker->out.length > 0 && !netBufferFlush(&worker->out, &worker->sock))
+            dropWorker(coord, worker);
+    }
+}
+
+static void expireLeases(COORDINATOR *coord) {
+    uint64_t now = timerMillis();
+
+    for (int i = 0; i < COORDINATOR_MAX_WORKERS; i++) {
+        WORKER *worker = &coord->workers[i];
+        if (!worker->active)
+            continue;
+        for (int j = 0; j < COORDINATOR_LEASES_PER_WORKER; j++) {
+            if (worker->leases[j].active && now >= worker->leases[j].expires) {
+                fprintf(stderr, "Lease %u of worker %d expired, reassigning\n", worker->leases[j].id, i);
+                reclaimLease(coord, &worker->leases[j]);
+            }
+        }
+    }
+}
+
+static int openListener(LSOCKET *sock, char *bindIP, unsigned short port) {
+    if (!socketCreate(sock, AF_INET, SOCK_STREAM))
+        zerror("socketCreate Error");
+    else if (socketBind(sock, bindIP, port) < 0)
+        zerror("socketBind Error");
+    else if (socketListen(sock, COORDINATOR_MAX_WORKERS))
+        zerror("socketListen Error");
+    else
+        return 1;
+    return 0;
+}
+
+int runCoordinator(char *bindIP, unsigned short bindPort, unsigned short workerPort) {
+    COORDINATOR *coord = (COORDINATOR *) calloc(1, sizeof(COORDINATOR));
+    struct timeval timeout;
+    fd_set sockset, writeset;
+    SOCKET maxSocket;
+
+    if (!openListener(&coord->listener, bindIP, bindPort) ||
+        !openListener(&coord->workerListener, bindIP, workerPort)) {
+        free(coord);
+        return 0;
+    }
+    printf("Coordinating workers on port %hu, waiting for connection on port %hu...\n", workerPort, bindPort);
+
+    while (1) {
+        FD_ZERO(&sockset);
+        FD_ZERO(&writeset);
+        FD_SET(coord->workerListener.msocket, &sockset);
+        maxSocket = coord->workerListener.msocket;
+        if (coord->hasUpstream) {
+            FD_SET(coord->upstream.msocket, &sockset);
+            if (coord->upstreamOut.length > 0)
+                FD_SET(coord->upstream.msocket, &writeset);
+            if (coord->upstream.msocket > maxSocket)
+                maxSocket = coord->upstream.msocket;
+        } else {
+            FD_SET(coord->listener.msocket, &sockset);
+            if (coord->listener.msocket > maxSocket)
+                maxSocket = coord->listener.msocket;
+        }
+        for (int i = 0; i < COORDINATOR_MAX_WORKERS; i++) {
+            if (!coord->workers[i].active)
+                continue;
+            FD_SET(coord->workers[i].sock.msocket, &sockset);
+            if (coord->workers[i].out.length > 0)
+                FD_SET(coord->workers[i].sock.msocket, &writeset);
+            if (coord->workers[i].sock.msocket > maxSocket)
+                maxSocket = coord->workers[i].sock.msocket;
+        }
+
+        timeout.tv_sec = COORDINATOR_POLL_INTERVAL / 1000;
+        timeout.tv_usec = (COORDINATOR_POLL_INTERVAL % 1000) * 1000;
+        if (select(maxSocket + 1, &sockset, &writeset, NULL, &timeout) < 0) {
+            zerror("Select error");
+            break;
+        }
+
+        if (!coord->hasUpstream && FD_ISSET(coord->listener.msocket, &sockset)) {
+            if (socketAccept(&coord->listener, &coord->upstream)) {
+                printf("Accepted Connection\n");
+                socketSetBlocking(&coord->upstream, 0);
+                netBufferInit(&coord->upstreamIn);
+                netBufferInit(&coord->upstreamOut);
+                coord->hasUpstream = 1;
+            } else {
+                zerror("Accept Error");
+            }
+        } else if (coord->hasUpstream && FD_ISSET(coord->upstream.msocket, &sockset)) {
+            handleUpstream(coord);
+        }
+        for (int i = 0; i < COORDINATOR_MAX_WORKERS; i++) {
+            if (coord->workers[i].active && FD_ISSET(coord->workers[i].sock.msocket, &sockset))
+                handleWorker(coord, &coord->workers[i]);
+        }
+        if (FD_ISSET(coord->workerListener.msocket, &sockset))
+            acceptWorker(coord);
+
+        expireLeases(coord);
+        flushAll(coord);
+    }
+
+    socketClose(&coord->listener);
+    socketClose(&coord->workerListener);
+    free(coord);
+    return 0;
+}
@@ -0,0 +1,202 @@
+/*
+MIT License
+
+Copyright (c) 2019 iagocq
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <jseminer/hashserver.h>
+#include <jseminer/job.h>
+
+#include <string.h>
+
+static int setupHashServer(HASH_SERVER *server, CL_MINER *miner, size_t *workSize) {
+    cl_int error;
+
+    memset(server, 0, sizeof(*server));
+    server->miner = miner;
+    memcpy(server->workSize, workSize, sizeof(server->workSize));
+    server->nitems = workSize[0] * workSize[1] * workSize[2];
+
+    server->kernel = clCreateKernel(miner->program, "sha256Digest", &error);
+    fCheckError(error);
+
+    server->jobBuffer =
+        clCreateBuffer(miner->context, CL_MEM_READ_ONLY, sizeof(server->jobData), NULL, &error);
+    fCheckError(error);
+    error = clSetKernelArg(server->kernel, 0, sizeof(cl_mem), &server->jobBuffer);
+    fCheckError(error);
+
+    // Host-allocated so that mapping them is free on devices that share memory with the host
+    for (int i = 0; i < HASHSERVER_BUFFERS; i++) {
+        server->digestBuffers[i] = clCreateBuffer(miner->context, CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR,
+                                                  (size_t) server->nitems * 32, NULL, &error);
+        fCheckError(error);
+    }
+
+    return 1;
+}
+
+static void releaseHashServer(HASH_SERVER *server) {
+    for (int i = 0; i < HASHSERVER_BUFFERS; i++) {
+        if (server->digestBuffers[i] != NULL)
+            clReleaseMemObject(server->digestBuffers[i]);
+    }
+    if (server->jobBuffer != NULL)
+        clReleaseMemObject(server->jobBuffer);
+    if (server->kernel != NULL)
+        clReleaseKernel(server->kernel);
+}
+
+static int enqueueChunk(HASH_SERVER *server, int buffer, cl_ulong nonce) {
+    cl_int error;
+
+    error = clSetKernelArg(server->kernel, 1, sizeof(cl_mem), &server->digestBuffers[buffer]);
+    fCheckError(error);
+    error = clSetKernelArg(server->kernel, 2, sizeof(cl_ulong), &nonce);
+    fCheckError(error);
+    error = clEnqueueNDRangeKernel(server->miner->commandQueue, server->kernel, 3, NULL, server->workSize,
+                                   NULL, 0, NULL, &server->done[buffer]);
+    fCheckError(error);
+    error = clFlush(server->miner->commandQueue);
+    fCheckError(error);
+
+    return 1;
+}
+
+// Returns 1 when sent, 0 when the client went away and -1 on OpenCL errors
+static int sendChunk(HASH_SERVER *server, LSOCKET *client, int buffer, size_t size) {
+    cl_int error;
+    int sent;
+    char *digests = (char *) clEnqueueMapBuffer(server->miner->commandQueue, server->digestBuffers[buffer],
+                                                CL_TRUE, CL_MAP_READ, 0, size, 1, &server->done[buffer], NULL,
+                                                &error);
+    clReleaseEvent(server->done[buffer]);
+    server->done[buffer] = NULL;
+    rCheckError(error, -1);
+
+    // Blocks while the client is slow to read, which keeps the device at most one chunk ahead
+    sent = socketSendAll(client, digests, (int) size);
+
+    error = clEnqueueUnmapMemObject(server->miner->commandQueue, server->digestBuffers[buffer], digests, 0,
+                                    NULL, NULL);
+    rCheckError(error, -1);
+
+    return sent > 0;
+}
+
+// Returns 1 when the request was served, 0 when the client went away and -1 on OpenCL errors
+static int serveRequest(HASH_SERVER *server, LSOCKET *client, char *request) {
+    cl_int error;
+    JOB job;
+    uint64_t startNonce, count, chunks;
+    cl_uint digestBytes;
+    int status = 1;
+
+    memcpy(job.prehash, request, 64);
+    memcpy(&startNonce, &request[64], 8);
+    memcpy(&count, &request[72], 8);
+    startNonce = ntohll(startNonce);
+    count = ntohll(count);
+    digestBytes = (unsigned char) request[80];
+    if (digestBytes < 1 || digestBytes > 32) {
+        fprintf(stderr, "Invalid digest size %u\n", digestBytes);
+        return 0;
+    }
+
+    // The previous request finished the queue, so jobData is free to reuse and the in-order queue runs this
+    // write before the first chunk
+    jobMidstate(&job, server->jobData);
+    error = clEnqueueWriteBuffer(server->miner->commandQueue, server->jobBuffer, CL_FALSE, 0,
+                                 sizeof(server->jobData), server->jobData, 0, NULL, NULL);
+    rCheckError(error, -1);
+    error = clSetKernelArg(server->kernel, 3, sizeof(cl_uint), &digestBytes);
+    rCheckError(error, -1);
+
+    chunks = (count + server->nitems - 1) / server->nitems;
+    for (uint64_t k = 0; k <= chunks && status == 1; k++) {
+        if (k < chunks && !enqueueChunk(server, k % HASHSERVER_BUFFERS, startNonce + k * server->nitems)) {
+            status = -1;
+            break;
+        }
+
+        if (k > 0) {
+            uint64_t remaining = count - (k - 1) * server->nitems;
+            size_t nonces = remaining < server->nitems ? (size_t) remaining : server->nitems;
+            status = sendChunk(server, client, (k - 1) % HASHSERVER_BUFFERS, nonces * digestBytes);
+        }
+    }
+
+    // Make sure nothing is left running on a buffer before the next request reuses it
+    clFinish(server->miner->commandQueue);
+    for (int i = 0; i < HASHSERVER_BUFFERS; i++) {
+        if (server->done[i] != NULL) {
+            clReleaseEvent(server->done[i]);
+            server->done[i] = NULL;
+        }
+    }
+
+    return status;
+}
+
+int runHashServer(CL_MINER *miner, size_t *workSize, char *bindIP, unsigned short bindPort) {
+    HASH_SERVER server;
+    LSOCKET sock, client;
+    char request[HASHSERVER_REQUEST_SIZE];
+    int status = 1;
+
+    if (!setupHashServer(&server, miner, workSize)) {
+        releaseHashServer(&server);
+        return 0;
+    }
+
+    if (!socketCreate(&sock, AF_INET, SOCK_STREAM)) {
+        zerror("socketCreate Error");
+        status = 0;
+    } else if (socketBind(&sock, bindIP, bindPort) < 0) {
+        zerror("socketBind Error");
+        status = 0;
+    } else if (socketListen(&sock, 0)) {
+        zerror("socketListen Error");
+        status = 0;
+    }
+
+    while (status) {
+        printf("Waiting for connection...\n");
+        if (!socketAccept(&sock, &client)) {
+            zerror("Accept Error");
+            continue;
+        }
+        printf("Accepted Connection\n");
+
+        while (socketRecvAll(&client, request, HASHSERVER_REQUEST_SIZE) > 0) {
+            int result = serveRequest(&server, &client, request);
+            if (result < 0)
+                status = 0;
+            if (result != 1)
+                break;
+        }
+        fprintf(stderr, "Closed connection\n");
+        socketClose(&client);
+    }
+
+    releaseHashServer(&server);
+    return status;
+}
@@ -0,0 +1,212 @@
+/*
+MIT License
+
+Copyright (c) 2019 iagocq
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <jseminer/job.h>
+#include <jseminer/sha256.h>
+
+#include <string.h>
+
+// The prehash fills exactly one SHA-256 block, so its state can be computed once per job
+void jobMidstate(JOB *job, uint32_t *hashedPrehash) {
+    sha256_init(hashedPrehash);
+    sha256_round((uint8_t *) job->prehash, hashedPrehash);
+}
+
+void jobDecode(char *buf, JOB *job) {
+    uint32_t mask;
+    uint64_t nonce;
+
+    memcpy(&mask, buf, 4);
+    memcpy(&nonce, &buf[4], 8);
+    job->difficultyMask = ntohl(mask);
+    job->startNonce = ntohll(nonce);
+    job->nonceCount = 0;
+    job->leaseId = 0;
+    job->generation = 0;
+    job->flags = 0;
+    memset(job->target, 0xFF, sizeof(job->target));
+    memcpy(job->prehash, &buf[12], 64);
+}
+
+void jobDecodeExtension(char *buf, JOB *job) {
+    uint32_t word;
+
+    memcpy(&word, buf, 4);
+    job->flags = ntohl(word);
+    for (int i = 0; i < 8; i++) {
+        memcpy(&word, &buf[4 + i * 4], 4);
+        job->target[i] = ntohl(word);
+    }
+}
+
+// Returns the size of the encoded packet, jobs with a difficulty mask of 0 carry their target
+int jobEncode(JOB *job, char *buf) {
+    uint32_t word = htonl(job->difficultyMask);
+    uint64_t nonce = htonll(job->startNonce);
+
+    memcpy(buf, &word, 4);
+    memcpy(&buf[4], &nonce, 8);
+    memcpy(&buf[12], job->prehash, 64);
+    if (job->difficultyMask != 0)
+        return JOB_PACKET_SIZE;
+
+    word = htonl(job->flags);
+    memcpy(&buf[JOB_PACKET_SIZE], &word, 4);
+    for (int i = 0; i < 8; i++) {
+        word = htonl(job->target[i]);
+        memcpy(&buf[JOB_PACKET_SIZE + 4 + i * 4], &word, 4);
+    }
+    return JOB_PACKET_MAX_SIZE;
+}
+
+// buf must hold JOB_PACKET_MAX_SIZE bytes. Returns what socketRecvAll returned for the last read
+int jobRecv(LSOCKET *sock, char *buf, JOB *job) {
+    int c;
+
+    if ((c = socketRecvAll(sock, buf, JOB_PACKET_SIZE)) < JOB_PACKET_SIZE)
+        return c;
+    jobDecode(buf, job);
+    if (job->difficultyMask != 0)
+        return c;
+
+    if ((c = socketRecvAll(sock, &buf[JOB_PACKET_SIZE], JOB_EXTENSION_SIZE)) < JOB_EXTENSION_SIZE)
+        return c;
+    jobDecodeExtension(&buf[JOB_PACKET_SIZE], job);
+    return JOB_PACKET_MAX_SIZE;
+}
+
+// Decodes a job from the first length bytes of buf. Returns the size of the packet, or 0 if it is incomplete
+int jobParse(char *buf, int length, JOB *job) {
+    if (length < JOB_PACKET_SIZE)
+        return 0;
+    jobDecode(buf, job);
+    if (job->difficultyMask != 0)
+        return JOB_PACKET_SIZE;
+
+    if (length < JOB_PACKET_MAX_SIZE)
+        return 0;
+    jobDecodeExtension(&buf[JOB_PACKET_SIZE], job);
+    return JOB_PACKET_MAX_SIZE;
+}
+
+// Same as jobParse for lease packets
+int leaseParse(char *buf, int length, JOB *job) {
+    uint32_t leaseId, generation;
+    uint64_t count;
+    int c;
+
+    if (length < LEASE_HEADER_SIZE)
+        return 0;
+    if ((c = jobParse(&buf[LEASE_HEADER_SIZE], length - LEASE_HEADER_SIZE, job)) == 0)
+        return 0;
+
+    memcpy(&leaseId, buf, 4);
+    memcpy(&generation, &buf[4], 4);
+    memcpy(&count, &buf[8], 8);
+    job->leaseId = ntohl(leaseId);
+    job->generation = ntohl(generation);
+    job->nonceCount = ntohll(count);
+    return LEASE_HEADER_SIZE + c;
+}
+
+int leaseEncode(JOB *job, char *buf) {
+    uint32_t leaseId = htonl(job->leaseId);
+    uint32_t generation = htonl(job->generation);
+    uint64_t count = htonll(job->nonceCount);
+
+    memcpy(buf, &leaseId, 4);
+    memcpy(&buf[4], &generation, 4);
+    memcpy(&buf[8], &count, 8);
+    return LEASE_HEADER_SIZE + jobEncode(job, &buf[LEASE_HEADER_SIZE]);
+}
+
+void shareDecode(char *buf, SHARE *share) {
+    uint64_t nonce;
+
+    memcpy(share->prehash, buf, 64);
+    memcpy(&nonce, &buf[64], 8);
+    share->nonce = ntohll(nonce);
+    share->leaseId = 0;
+}
+
+void shareEncode(SHARE *share, char *buf) {
+    uint64_t nonce = htonll(share->nonce);
+
+    memcpy(buf, share->prehash, 64);
+    memcpy(&buf[64], &nonce, 8);
+}
+
+void weightedShareEncode(SHARE *share, uint32_t weight, char *buf) {
+    weight = htonl(weight);
+
+    shareEncode(share, buf);
+    memcpy(&buf[SHARE_PACKET_SIZE], &weight, 4);
+}
+
+void jobQueueInit(JOB_QUEUE *queue) {
+    queue->head = 0;
+    queue->count = 0;
+}
+
+// Returns 0 if the queue was full and its oldest job had to be dropped
+int jobQueuePush(JOB_QUEUE *queue, JOB *job) {
+    int dropped = 0;
+
+    if (queue->count == JOB_QUEUE_SIZE) {
+        queue->head = (queue->head + 1) % JOB_QUEUE_SIZE;
+        queue->count--;
+        dropped = 1;
+    }
+    queue->jobs[(queue->head + queue->count) % JOB_QUEUE_SIZE] = *job;
+    queue->count++;
+    return !dropped;
+}
+
+int jobQueuePop(JOB_QUEUE *queue, JOB *job) {
+    if (queue->count == 0)
+        return 0;
+
+    *job = queue->jobs[queue->head];
+    queue->head = (queue->head + 1) % JOB_QUEUE_SIZE;
+    queue->count--;
+    return 1;
+}
+
+JOB *jobQueuePeek(JOB_QUEUE *queue) {
+    if (queue->count == 0)
+        return NULL;
+    return &queue->jobs[queue->head];
+}
+// Removes every queued job whose generation differs from generation, i.e. leases of a job that was replaced
+// Removes every queued job that works on a different prehash
+void jobQueueDropStale(JOB_QUEUE *queue, uint32_t generation) {
+    int kept = 0;
+
+    for (int i = 0; i < queue->count; i++) {
+        JOB *job = &queue->jobs[(queue->head + i) % JOB_QUEUE_SIZE];
+        if (job->generation == generation)
+            queue->jobs[(queue->head + kept++) % JOB_QUEUE_SIZE] = *job;
+    }
+    queue->count = kept;
+}
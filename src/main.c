@@ -22,12 +22,20 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
-#define CL_TARGET_OPENCL_VERSION 120
+#define CL_TARGET_OPENCL_VERSION 200
+#define CL_USE_DEPRECATED_OPENCL_1_2_APIS
 
 #include <CL/cl.h>
 #include <getopt.h>
 #include <inttypes.h>
+#include <jseminer/adapt.h>
+#include <jseminer/batch.h>
+#include <jseminer/client.h>
+#include <jseminer/coordinator.h>
+#include <jseminer/hashserver.h>
+#include <jseminer/job.h>
 #include <jseminer/miner.h>
+#include <jseminer/persistent.h>
 #include <jseminer/sha256.cl.h>
 #include <jseminer/sha256.h>
 #include <jseminer/socket.h>
@@ -41,25 +49,19 @@ SOFTWARE.
 #include <sys/time.h>
 #endif
 
-int doMineRound(CL_MINER *miner, size_t *workSize, cl_mem resultBuffer, uint8_t *result) {
-    cl_uint nitems = workSize[0] * workSize[1] * workSize[2];
-    cl_int error = 0;
-
-    error =
-        clEnqueueNDRangeKernel(miner->commandQueue, miner->kernel, 3, NULL, workSize, NULL, 0, NULL, NULL);
-    fCheckError(error);
-
-    error = clFinish(miner->commandQueue);
-    fCheckError(error);
-
-    error = clEnqueueReadBuffer(miner->commandQueue, resultBuffer, CL_TRUE, 0, nitems, result, 0, NULL, NULL);
-    checkError(error);
-
-    return 1;
+// Jobs that opt in to adaptation get weighted shares even when the miner does not adapt, so clients know what
+// to expect
+static void sendShare(LSOCKET *client, JOB *job, SHARE *share, unsigned int shift, char *netBuf) {
+    if (job->flags & JOB_FLAG_ADAPT) {
+        weightedShareEncode(share, 1u << shift, netBuf);
+        socketSend(client, netBuf, WEIGHTED_SHARE_PACKET_SIZE);
+    } else {
+        shareEncode(share, netBuf);
+        socketSend(client, netBuf, SHARE_PACKET_SIZE);
+    }
 }
 
 int main(int argc, char *argv[]) {
-    cl_int error = 0;
     size_t globalWorkSize[3];
     unsigned int deviceIdx, platformIdx;
 
@@ -68,31 +70,115 @@ int main(int argc, char *argv[]) {
 
     unsigned short bindPort = 9854;
     char *bindIP = "127.0.0.1";
+    char *poolIP = NULL;
+    unsigned short poolPort = 0;
+    unsigned short workerPort = 0;
+    int persistent = 0;
+    int serveHashes = 0;
+    char *batchFile = NULL;
+    int sharesPerJob = 1;
+    double sharesPerMinute = 0;
+    int adapting = 0;
+    unsigned int minedShift = 0;
     int c;
     int connected = 0;
     int end = 0;
 
-    cl_ulong startNonce = 0;
-    cl_uint difficultyMask = 0xFFFF0000;
-    char prehash[64];
-    uint32_t hashedPrehash[8];
+    JOB job;
+    JOB minedJob;
+    SHARE share;
+    SHARE polledShares[64];
 
     CL_MINER miner;
+    PERSISTENT_MINER pminer;
+    SHARE_ADAPTER adapter;
 
-    char netBuf[72];
+    char netBuf[JOB_PACKET_MAX_SIZE];
 
     struct timeval defaultTimeout = {0, 0};
+    // A persistent kernel needs no host work between polls, so there is no point in spinning
+    struct timeval persistentTimeout = {0, 1000};
+
+    while ((c = getopt(argc, argv, "c:C:PHb:n:a:")) != -1) {
+        switch (c) {
+        case 'c': {
+            char *colon = strrchr(optarg, ':');
+            if (colon == NULL) {
+                fprintf(stderr, "Pool address must be in the form <IP>:<port>\n");
+                return EXIT_FAILURE;
+            }
+            *colon = '\0';
+            poolIP = optarg;
+            poolPort = (unsigned short) atoi(colon + 1);
+            break;
+        }
+        case 'C':
+            workerPort = (unsigned short) atoi(optarg);
+            break;
+        case 'P':
+            persistent = 1;
+            break;
+        case 'H':
+            serveHashes = 1;
+            break;
+        case 'b':
+            batchFile = optarg;
+            break;
+        case 'n':
+            sharesPerJob = atoi(optarg);
+            if (sharesPerJob < 1) {
+                fprintf(stderr, "The number of shares per job must be at least 1\n");
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'a':
+            sharesPerMinute = atof(optarg);
+            if (sharesPerMinute <= 0) {
+                fprintf(stderr, "The share rate must be greater than 0\n");
+                return EXIT_FAILURE;
+            }
+            break;
+        default:
+            return EXIT_FAILURE;
+        }
+    }
+    int nargs = argc - optind;
+    char **args = argv + optind;
+
+    if (workerPort != 0) {
+        if (nargs > 0) {
+            bindPort = (unsigned short) atoi(args[0]);
+        }
+        if (nargs > 1) {
+            bindIP = args[1];
+        }
 
-    if (argc < 6) {
+        socketInit();
+        end = !runCoordinator(bindIP, bindPort, workerPort);
+        socketDeInit();
+        return end ? EXIT_FAILURE : 0;
+    }
+
+    if (nargs < 5) {
         fprintf(stderr,
-                "Usage: %s <platform ID> <device ID> <Work Dim 0> <Work Dim 1> <Work Dim 2> [bind port] "
-                "[bind IP]\n",
+                "Usage: %s [-P | -H | -b <job file> [-n <shares>]] [-a <shares per minute>] "
+                "[-c <pool IP>:<pool port>]\n"
+                "       <platform ID> <device ID> <Work Dim 0> <Work Dim 1> <Work Dim 2> "
+                "[bind port] [bind IP]\n",
                 argv[0]);
+        fprintf(stderr, "       %s -C <worker port> [bind port] [bind IP]\n", argv[0]);
         fprintf(stderr, "Running without any of the <required arguments> will show values to use for them "
                         "and this message\n");
         fprintf(stderr, "Default bind port: %hu\n", bindPort);
         fprintf(stderr, "Default bind IP: %s\n", bindIP);
         fprintf(stderr, "This program will only allow 1 connection at a time\n");
+        fprintf(stderr, "With -c, connects out to a pool instead of listening for a client\n");
+        fprintf(stderr, "With -C, splits each job among miners started with -c <bind IP>:<worker port>\n");
+        fprintf(stderr, "With -P, keeps the kernel running between jobs on OpenCL 2.0 devices\n");
+        fprintf(stderr, "With -H, serves full digests for nonce ranges instead of mining\n");
+        fprintf(stderr, "With -b, mines the first -n shares (default 1) of every job in a file, "
+                        "- for stdin\n");
+        fprintf(stderr, "With -a, keeps clients that opt in near -a shares a minute\n");
     }
 
     socketInit();
@@ -103,14 +189,14 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "No OpenCL platforms available\n");
         return EXIT_FAILURE;
     }
-    if (argc < 2) {
+    if (nargs < 1) {
         printf("Platforms:\n");
         for (cl_uint i = 0; i < miner.platformCount; i++) {
             printf("ID %u:\t%s\n", i, getPlatformName(miner.platforms[i]));
         }
         return 0;
     }
-    platformIdx = atoi(argv[1]);
+    platformIdx = atoi(args[0]);
     if (platformIdx > miner.platformCount) {
         fprintf(stderr, "Invalid platform ID\n");
         return 1;
@@ -121,56 +207,108 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "No OpenCL devices available on this platform\n");
         return EXIT_FAILURE;
     }
-    if (argc < 3) {
+    if (nargs < 2) {
         printf("Devices:\n");
         for (cl_uint i = 0; i < miner.deviceCount; i++) {
             printf("ID %u:\t%s\n", i, getDeviceName(miner.devices[i]));
         }
         return 0;
     }
-    deviceIdx = atoi(argv[1]);
+    deviceIdx = atoi(args[1]);
     if (deviceIdx > platformIdx) {
         fprintf(stderr, "Invalid device ID\n");
         return 1;
     }
 
     getMaxWorkDimensions(&miner, miner.devices[0]);
-    if (argc < 6) {
-        printf("Max Dimensions: [%u, %u, %u]\n", miner.maxWorkDimensions[0], miner.maxWorkDimensions[1],
+    if (nargs < 5) {
+        printf("Max Dimensions: [%zu, %zu, %zu]\n", miner.maxWorkDimensions[0], miner.maxWorkDimensions[1],
                miner.maxWorkDimensions[2]);
         return 0;
     }
-    globalWorkSize[0] = (size_t) atoi(argv[3]);
-    globalWorkSize[1] = (size_t) atoi(argv[4]);
-    globalWorkSize[2] = (size_t) atoi(argv[5]);
+    globalWorkSize[0] = (size_t) atoi(args[2]);
+    globalWorkSize[1] = (size_t) atoi(args[3]);
+    globalWorkSize[2] = (size_t) atoi(args[4]);
     for (int i = 0; i < 3; i++) {
         if (globalWorkSize[i] > miner.maxWorkDimensions[i]) {
-            fprintf(stderr, "Work Dim %d is greater than the maximum for dimension %d, setting to %d", i, i);
+            fprintf(stderr, "Work Dim %d is greater than the maximum for dimension %d, setting to %zu\n", i,
+                    i, miner.maxWorkDimensions[i]);
             globalWorkSize[i] = miner.maxWorkDimensions[i];
         }
     }
 
-    if (argc > 6) {
-        bindPort = (unsigned short) atoi(argv[6]);
+    if (nargs > 5) {
+        bindPort = (unsigned short) atoi(args[5]);
     }
-    if (argc > 7) {
-        bindIP = argv[7];
+    if (nargs > 6) {
+        bindIP = args[6];
     }
 
-    if (!setupMiner(&miner, miner.platforms[0], miner.devices[0], sha256CLSource, "sha256")) {
+    if (persistent && (poolIP != NULL || serveHashes || batchFile != NULL)) {
+        fprintf(stderr, "Persistent kernels are only used when mining for a client, "
+                        "using regular launches\n");
+        persistent = 0;
+    }
+    if (persistent && sharesPerMinute > 0) {
+        fprintf(stderr, "Share rate adaptation retargets between launches, using regular launches\n");
+        persistent = 0;
+    }
+    if (persistent && !isPersistentSupported(miner.devices[0])) {
+        fprintf(stderr, "Persistent kernels need OpenCL 2.0 with fine-grained SVM atomics and 64-bit "
+                        "atomics, using regular launches\n");
+        persistent = 0;
+    }
+
+    if (!setupMiner(&miner, miner.platforms[0], miner.devices[0], sha256CLSource, "sha256",
+                    persistent ? PERSISTENT_BUILD_OPTIONS : NULL)) {
         fprintf(stderr, "Failed to setup miner\n");
         return EXIT_FAILURE;
     }
 
     uint32_t nitems = globalWorkSize[0] * globalWorkSize[1] * globalWorkSize[2];
 
-    cl_mem resultBuffer =
-        clCreateBuffer(miner.context, CL_MEM_WRITE_ONLY, nitems * sizeof(cl_uchar), NULL, &error);
+    if (!createMinerBuffers(&miner, nitems)) {
+        fprintf(stderr, "Failed to create buffers\n");
+        return EXIT_FAILURE;
+    }
+
+    if (serveHashes) {
+        end = !runHashServer(&miner, globalWorkSize, bindIP, bindPort);
+
+        socketDeInit();
+        releaseMiner(&miner);
+        return end ? EXIT_FAILURE : 0;
+    }
+
+    if (batchFile != NULL) {
+        FILE *input = strcmp(batchFile, "-") ? fopen(batchFile, "r") : stdin;
+        if (input == NULL) {
+            perror(batchFile);
+            return EXIT_FAILURE;
+        }
+        end = !runBatch(&miner, globalWorkSize, input, sharesPerJob);
+        if (input != stdin)
+            fclose(input);
+
+        socketDeInit();
+        releaseMiner(&miner);
+        return end ? EXIT_FAILURE : 0;
+    }
 
-    uint8_t *roundResult = (uint8_t *) malloc(nitems * sizeof(uint8_t));
-    clSetKernelArg(miner.kernel, 1, sizeof(cl_mem), &resultBuffer);
+    if (poolIP != NULL) {
+        end = !runClient(&miner, globalWorkSize, poolIP, poolPort);
 
-    cl_mem prehashBuffer = NULL;
+        socketDeInit();
+        releaseMiner(&miner);
+        return end ? EXIT_FAILURE : 0;
+    }
+
+    if (persistent && !setupPersistent(&pminer, &miner, globalWorkSize)) {
+        fprintf(stderr, "Failed to setup persistent kernel\n");
+        return EXIT_FAILURE;
+    }
+
+    uint8_t *roundResult;
 
     end = 1;
 
@@ -190,88 +328,114 @@ int main(int argc, char *argv[]) {
                 zerror("Accept Error");
             }
             printf("Accepted Connection\n");
+            // Every client starts from its own difficulty
+            adapterInit(&adapter, sharesPerMinute / 60);
 
-            if ((c = socketRecv(client, netBuf, 76)) < 76) {
-                fprintf(stderr, "Wrong packet size (expected 76, but got %d).\n", c);
+            if (jobRecv(client, netBuf, &job) <= 0) {
+                fprintf(stderr, "Failed to receive a job\n");
                 socketClose(client);
             } else {
-                difficultyMask = ntohl(((uint32_t *) netBuf)[0]);
-                startNonce = ((uint64_t *) &netBuf[4])[0];
-                startNonce = ntohll(startNonce);
-                memcpy(prehash, &netBuf[12], 64);
                 connected = 1;
 
-                sha256_init(hashedPrehash);
-                sha256_round((uint8_t *) prehash, hashedPrehash);
-
-                if (prehashBuffer != NULL)
-                    clReleaseMemObject(prehashBuffer);
-
-                prehashBuffer = clCreateBuffer(miner.context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, 64,
-                                               hashedPrehash, &error);
-
-                clSetKernelArg(miner.kernel, 0, sizeof(cl_mem), &prehashBuffer);
-                clSetKernelArg(miner.kernel, 3, sizeof(cl_uint), &difficultyMask);
+                if (persistent) {
+                    if (!setPersistentJob(&pminer, &job)) {
+                        socketClose(client);
+                        end = 1;
+                        break;
+                    }
+                } else {
+                    adapting = sharesPerMinute > 0 && (job.flags & JOB_FLAG_ADAPT);
+                    minedShift = adaptJob(&job, adapting ? adapter.shift : 0, &minedJob);
+                    if (!setMinerJob(&miner, &minedJob)) {
+                        socketClose(client);
+                        end = 1;
+                        break;
+                    }
+                }
             }
         } while (!connected);
-        cl_ulong nonce = startNonce;
+        if (end)
+            break;
+        cl_ulong nonce = job.startNonce;
         do {
             fd_set sockset;
             FD_ZERO(&sockset);
             FD_SET(client->msocket, &sockset);
-            int result = select(client->msocket + 1, &sockset, NULL, NULL, &defaultTimeout);
+            struct timeval timeout = persistent ? persistentTimeout : defaultTimeout;
+            int result = select(client->msocket + 1, &sockset, NULL, NULL, &timeout);
             if (result == 1) {
-                if ((c = socketRecv(client, netBuf, 76)) < 76) {
-                    if (c <= 0) {
-                        fprintf(stderr, "Closed connection\n");
-                        connected = 0;
-                    } else {
-                        fprintf(stderr, "Wrong packet size (expected 76, but got %d).\n", c);
-                    }
+                if (jobRecv(client, netBuf, &job) <= 0) {
+                    fprintf(stderr, "Closed connection\n");
+                    socketClose(client);
+                    connected = 0;
                 } else {
-                    difficultyMask = ntohl(((uint32_t *) netBuf)[0]);
-                    startNonce = ((uint64_t *) &netBuf[4])[0];
-                    startNonce = ntohll(startNonce);
-                    memcpy(prehash, &netBuf[12], 64);
-                    nonce = startNonce;
-
-                    sha256_init(hashedPrehash);
-                    sha256_round((uint8_t *) prehash, hashedPrehash);
-
-                    if (prehashBuffer != NULL)
-                        clReleaseMemObject(prehashBuffer);
-
-                    prehashBuffer = clCreateBuffer(miner.context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, 64,
-                                                   hashedPrehash, &error);
+                    nonce = job.startNonce;
 
-                    clSetKernelArg(miner.kernel, 0, sizeof(cl_mem), &prehashBuffer);
-                    clSetKernelArg(miner.kernel, 3, sizeof(cl_uint), &difficultyMask);
+                    if (persistent) {
+                        if (!setPersistentJob(&pminer, &job)) {
+                            end = 1;
+                            break;
+                        }
+                    } else {
+                        adapting = sharesPerMinute > 0 && (job.flags & JOB_FLAG_ADAPT);
+                        minedShift = adaptJob(&job, adapting ? adapter.shift : 0, &minedJob);
+                        if (!setMinerJob(&miner, &minedJob)) {
+                            end = 1;
+                            break;
+                        }
+                    }
+                }
+            } else if (result == 0 && persistent) {
+                int count = pollPersistentShares(&pminer, polledShares, 64);
+                for (int i = 0; i < count; i++) {
+                    sendShare(client, &job, &polledShares[i], 0, netBuf);
                 }
             } else if (result == 0) {
+                uint64_t roundShares = 0;
+
                 clSetKernelArg(miner.kernel, 2, sizeof(cl_ulong), &nonce);
-                if (!doMineRound(&miner, globalWorkSize, resultBuffer, roundResult)) {
+                if (!doMineRound(&miner, globalWorkSize, &roundResult)) {
                     fprintf(stderr, "Mine error!\n");
                     end = 1;
+                    break;
                 }
-                for (int i = 0; i < nitems; i++) {
+                for (uint32_t i = 0; i < nitems; i++) {
                     if (roundResult[i] == 1) {
-                        ((uint64_t *) netBuf)[0] = htonll(nonce + i);
-                        socketSend(client, prehash, 64);
-                        socketSend(client, netBuf, 8);
+                        memcpy(share.prehash, job.prehash, 64);
+                        share.nonce = nonce + i;
+                        sendShare(client, &job, &share, minedShift, netBuf);
+                        roundShares++;
                     }
                 }
+                if (!endMineRound(&miner, roundResult)) {
+                    end = 1;
+                    break;
+                }
                 nonce += nitems;
+
+                if (adapting && adapterUpdate(&adapter, roundShares)) {
+                    minedShift = adaptJob(&job, adapter.shift, &minedJob);
+                    printf("Share rate adapted, each share now weighs %u\n", 1u << minedShift);
+                    if (!setMinerJob(&miner, &minedJob)) {
+                        end = 1;
+                        break;
+                    }
+                }
             } else {
                 printf("Select error!\n");
                 socketClose(client);
                 connected = 0;
             }
         } while (connected && !end);
+
+        if (persistent)
+            stopPersistent(&pminer);
     }
 
     socketDeInit();
 
-    clReleaseMemObject(resultBuffer);
+    if (persistent)
+        releasePersistent(&pminer);
     releaseMiner(&miner);
 
     return 0;
@@ -23,6 +23,7 @@ SOFTWARE.
 */
 
 #include <jseminer/miner.h>
+#include <string.h>
 
 void _checkError(int line, cl_int error) {
     if (error != CL_SUCCESS) {
@@ -66,7 +67,8 @@ cl_program createProgram(char *source, size_t len, cl_context context, cl_int *e
     return program;
 }
 
-int setupMiner(CL_MINER *miner, cl_platform_id platform, cl_device_id device, char *source, char *kernel) {
+int setupMiner(CL_MINER *miner, cl_platform_id platform, cl_device_id device, char *source, char *kernel,
+               char *options) {
     cl_int error;
 
     cl_context_properties contextProperties[] = {CL_CONTEXT_PLATFORM, (cl_context_properties) platform, 0, 0};
@@ -78,7 +80,7 @@ int setupMiner(CL_MINER *miner, cl_platform_id platform, cl_device_id device, ch
     miner->program = createProgram(source, 0, miner->context, &error);
     fCheckError(error);
 
-    error = clBuildProgram(miner->program, miner->deviceCount, miner->devices, NULL, NULL, NULL);
+    error = clBuildProgram(miner->program, miner->deviceCount, miner->devices, options, NULL, NULL);
     if (error == CL_BUILD_PROGRAM_FAILURE) {
         size_t logSize;
         clGetProgramBuildInfo(miner->program, device, CL_PROGRAM_BUILD_LOG, 0, NULL, &logSize);
@@ -89,11 +91,17 @@ int setupMiner(CL_MINER *miner, cl_platform_id platform, cl_device_id device, ch
     }
     fCheckError(error);
 
-    miner->kernel = clCreateKernel(miner->program, "sha256", &error);
+    miner->kernel = clCreateKernel(miner->program, kernel, &error);
     fCheckError(error);
     miner->commandQueue = clCreateCommandQueue(miner->context, device, 0, &error);
     fCheckError(error);
 
+    cl_bool unified = CL_FALSE;
+    cl_device_type type = 0;
+    clGetDeviceInfo(device, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(unified), &unified, NULL);
+    clGetDeviceInfo(device, CL_DEVICE_TYPE, sizeof(type), &type, NULL);
+    miner->unifiedMemory = unified || (type & CL_DEVICE_TYPE_CPU);
+
     return 1;
 }
 
@@ -124,7 +132,110 @@ int getMaxWorkDimensions(CL_MINER *miner, cl_device_id device) {
                     miner->maxWorkDimensions, NULL);
 }
 
+// On devices that share memory with the host, host-allocated buffers can be mapped without a copy
+cl_mem createMappableBuffer(CL_MINER *miner, cl_mem_flags flags, size_t size, cl_int *error) {
+    if (miner->unifiedMemory)
+        flags |= CL_MEM_ALLOC_HOST_PTR;
+    return clCreateBuffer(miner->context, flags, size, NULL, error);
+}
+
+int createMinerBuffers(CL_MINER *miner, size_t nitems) {
+    cl_int error;
+
+    for (int i = 0; i < MINER_JOB_SLOTS; i++) {
+        miner->jobBuffers[i] =
+            createMappableBuffer(miner, CL_MEM_READ_ONLY, sizeof(miner->jobData[i]), &error);
+        fCheckError(error);
+    }
+
+    miner->resultBuffer = createMappableBuffer(miner, CL_MEM_WRITE_ONLY, nitems * sizeof(cl_uchar), &error);
+    fCheckError(error);
+    if (!miner->unifiedMemory)
+        miner->hostResult = (uint8_t *) malloc(nitems * sizeof(uint8_t));
+
+    error = clSetKernelArg(miner->kernel, 1, sizeof(cl_mem), &miner->resultBuffer);
+    fCheckError(error);
+
+    return 1;
+}
+
+int setMinerJob(CL_MINER *miner, JOB *job) {
+    cl_int error;
+    int slot = (miner->jobSlot + 1) % MINER_JOB_SLOTS;
+
+    // Only waits when jobs arrive faster than the queue can take them
+    if (miner->jobWritten[slot] != NULL) {
+        error = clWaitForEvents(1, &miner->jobWritten[slot]);
+        fCheckError(error);
+        clReleaseEvent(miner->jobWritten[slot]);
+        miner->jobWritten[slot] = NULL;
+    }
+
+    // Midstate followed by the target, as the kernel expects them
+    jobMidstate(job, miner->jobData[slot]);
+    memcpy(&miner->jobData[slot][8], job->target, sizeof(job->target));
+
+    error = clEnqueueWriteBuffer(miner->commandQueue, miner->jobBuffers[slot], CL_FALSE, 0,
+                                 sizeof(miner->jobData[slot]), miner->jobData[slot], 0, NULL,
+                                 &miner->jobWritten[slot]);
+    fCheckError(error);
+    miner->jobSlot = slot;
+
+    error = clSetKernelArg(miner->kernel, 0, sizeof(cl_mem), &miner->jobBuffers[slot]);
+    fCheckError(error);
+    error = clSetKernelArg(miner->kernel, 3, sizeof(cl_uint), &job->difficultyMask);
+    fCheckError(error);
+
+    return 1;
+}
+
+// Points result at the flags of the round, which stay valid until endMineRound
+int doMineRound(CL_MINER *miner, size_t *workSize, uint8_t **result) {
+    cl_uint nitems = workSize[0] * workSize[1] * workSize[2];
+    cl_int error = 0;
+
+    error =
+        clEnqueueNDRangeKernel(miner->commandQueue, miner->kernel, 3, NULL, workSize, NULL, 0, NULL, NULL);
+    fCheckError(error);
+
+    if (miner->unifiedMemory) {
+        *result = (uint8_t *) clEnqueueMapBuffer(miner->commandQueue, miner->resultBuffer, CL_TRUE,
+                                                 CL_MAP_READ, 0, nitems, 0, NULL, NULL, &error);
+        fCheckError(error);
+    } else {
+        error = clEnqueueReadBuffer(miner->commandQueue, miner->resultBuffer, CL_TRUE, 0, nitems,
+                                    miner->hostResult, 0, NULL, NULL);
+        fCheckError(error);
+        *result = miner->hostResult;
+    }
+
+    return 1;
+}
+
+int endMineRound(CL_MINER *miner, uint8_t *result) {
+    cl_int error;
+
+    if (!miner->unifiedMemory)
+        return 1;
+
+    error = clEnqueueUnmapMemObject(miner->commandQueue, miner->resultBuffer, result, 0, NULL, NULL);
+    fCheckError(error);
+
+    return 1;
+}
+
 void releaseMiner(CL_MINER *miner) {
+    for (int i = 0; i < MINER_JOB_SLOTS; i++) {
+        if (miner->jobWritten[i] != NULL)
+            clReleaseEvent(miner->jobWritten[i]);
+        if (miner->jobBuffers[i] != NULL)
+            clReleaseMemObject(miner->jobBuffers[i]);
+    }
+    if (miner->resultBuffer != NULL)
+        clReleaseMemObject(miner->resultBuffer);
+    if (miner->hostResult != NULL)
+        free(miner->hostResult);
+
     if (miner->devices != NULL)
         free(miner->devices);
     if (miner->platforms != NULL)
@@ -138,4 +249,4 @@ void releaseMiner(CL_MINER *miner) {
     clReleaseContext(miner->context);
 }
 
-void initMiner(CL_MINER *miner) { memset(miner, 0, sizeof(miner)); }
+void initMiner(CL_MINER *miner) { memset(miner, 0, sizeof(*miner)); }
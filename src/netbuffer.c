@@ -0,0 +1,73 @@
+/*
+MIT License
+
+Copyright (c) 2019 iagocq
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <jseminer/netbuffer.h>
+
+#include <string.h>
+
+void netBufferInit(NET_BUFFER *buffer) { buffer->length = 0; }
+
+// Reads what the socket has without blocking. Returns 0 when the peer closed the connection or on errors
+int netBufferFill(NET_BUFFER *buffer, LSOCKET *sock) {
+    while (buffer->length < NET_BUFFER_SIZE) {
+        int c = socketRecv(sock, &buffer->data[buffer->length], NET_BUFFER_SIZE - buffer->length);
+        if (c == 0)
+            return 0;
+        if (c < 0)
+            return socketWouldBlock();
+        buffer->length += c;
+    }
+    return 1;
+}
+
+void netBufferConsume(NET_BUFFER *buffer, int count) {
+    buffer->length -= count;
+    memmove(buffer->data, &buffer->data[count], buffer->length);
+}
+
+// Queues a whole message or nothing. Returns 0 when it does not fit
+int netBufferQueue(NET_BUFFER *buffer, char *data, int length) {
+    if (buffer->length + length > NET_BUFFER_SIZE)
+        return 0;
+    memcpy(&buffer->data[buffer->length], data, length);
+    buffer->length += length;
+    return 1;
+}
+
+// Sends what the socket takes without blocking. Returns 0 on errors
+int netBufferFlush(NET_BUFFER *buffer, LSOCKET *sock) {
+    int sent = 0;
+
+    while (sent < buffer->length) {
+        int c = socketSend(sock, &buffer->data[sent], buffer->length - sent);
+        if (c <= 0) {
+            if (c < 0 && socketWouldBlock())
+                break;
+            return 0;
+        }
+        sent += c;
+    }
+    netBufferConsume(buffer, sent);
+    return 1;
+}
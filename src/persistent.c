@@ -0,0 +1,218 @@
+/*
+MIT License
+
+Copyright (c) 2019 iagocq
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <jseminer/persistent.h>
+
+#include <string.h>
+
+int isPersistentSupported(cl_device_id device) {
+#ifdef CL_VERSION_2_0
+    char version[128];
+    char *extensions;
+    size_t size = 0;
+    int major = 0;
+    int supported;
+    cl_device_svm_capabilities svm = 0;
+
+    if (clGetDeviceInfo(device, CL_DEVICE_VERSION, sizeof(version), version, NULL) != CL_SUCCESS)
+        return 0;
+    version[sizeof(version) - 1] = '\0';
+    if (sscanf(version, "OpenCL %d.", &major) != 1 || major < 2)
+        return 0;
+
+    if (clGetDeviceInfo(device, CL_DEVICE_SVM_CAPABILITIES, sizeof(svm), &svm, NULL) != CL_SUCCESS)
+        return 0;
+    if (!(svm & CL_DEVICE_SVM_FINE_GRAIN_BUFFER) || !(svm & CL_DEVICE_SVM_ATOMICS))
+        return 0;
+
+    clGetDeviceInfo(device, CL_DEVICE_EXTENSIONS, 0, NULL, &size);
+    extensions = (char *) malloc(size + 1);
+    clGetDeviceInfo(device, CL_DEVICE_EXTENSIONS, size, extensions, NULL);
+    extensions[size] = '\0';
+    supported = strstr(extensions, "cl_khr_int64_base_atomics") != NULL &&
+                strstr(extensions, "cl_khr_int64_extended_atomics") != NULL;
+    free(extensions);
+
+    return supported;
+#else
+    return 0;
+#endif
+}
+
+int setupPersistent(PERSISTENT_MINER *pminer, CL_MINER *miner, size_t *workSize) {
+#ifdef CL_VERSION_2_0
+    cl_int error;
+
+    memset(pminer, 0, sizeof(*pminer));
+    pminer->miner = miner;
+    memcpy(pminer->workSize, workSize, sizeof(pminer->workSize));
+
+    pminer->kernel = clCreateKernel(miner->program, "sha256Persistent", &error);
+    fCheckError(error);
+
+    pminer->state = (PERSISTENT_STATE *) clSVMAlloc(
+        miner->context, CL_MEM_READ_WRITE | CL_MEM_SVM_FINE_GRAIN_BUFFER | CL_MEM_SVM_ATOMICS,
+        sizeof(PERSISTENT_STATE), 0);
+    if (pminer->state == NULL) {
+        fprintf(stderr, "Failed to allocate shared virtual memory\n");
+        return 0;
+    }
+    memset(pminer->state, 0, sizeof(PERSISTENT_STATE));
+
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+#ifdef CL_VERSION_2_0
+// Fills the slot of the next epoch, which is also the slot of the epoch before the current one. Work items
+// still on that epoch keep reading the target while it is overwritten, this is only safe because
+// pollPersistentShares discards every share tagged with an older epoch.
+static cl_uint writeJobSlot(PERSISTENT_MINER *pminer, JOB *job) {
+    cl_uint epoch = (pminer->epoch + 1) & PERSISTENT_EPOCH_MASK;
+    PERSISTENT_JOB *slot = &pminer->state->jobs[epoch & 1];
+
+    slot->difficultyMask = job->difficultyMask;
+    slot->startNonce = job->startNonce;
+    jobMidstate(job, slot->hashedPrehash);
+    memcpy(slot->target, job->target, sizeof(slot->target));
+    pminer->jobs[epoch & 1] = *job;
+
+    return epoch;
+}
+
+// Continues the current job from the first unclaimed nonce under a new epoch, which resets the chunk counter.
+// The swap only succeeds if no chunk was claimed in between, so no nonce is skipped or hashed twice.
+static void rebasePersistentJob(PERSISTENT_MINER *pminer, cl_ulong work) {
+    JOB job = pminer->jobs[pminer->epoch & 1];
+    cl_uint epoch;
+
+    do {
+        job.startNonce = pminer->jobs[pminer->epoch & 1].startNonce +
+                         (work & PERSISTENT_CHUNK_MASK) * PERSISTENT_CHUNK_SIZE;
+        epoch = writeJobSlot(pminer, &job);
+    } while (!atomic_compare_exchange_weak_explicit(&pminer->state->work, &work,
+                                                    (cl_ulong) epoch << PERSISTENT_EPOCH_SHIFT,
+                                                    memory_order_release, memory_order_relaxed));
+
+    pminer->epoch = epoch;
+    pminer->rebased = 1;
+}
+#endif
+
+// Switches the running kernel to a new job without relaunching it, or launches it for the first job
+int setPersistentJob(PERSISTENT_MINER *pminer, JOB *job) {
+#ifdef CL_VERSION_2_0
+    cl_int error;
+    cl_uint chunkSize = PERSISTENT_CHUNK_SIZE;
+    cl_uint epoch = writeJobSlot(pminer, job);
+
+    atomic_store_explicit(&pminer->state->work, (cl_ulong) epoch << PERSISTENT_EPOCH_SHIFT,
+                          memory_order_release);
+    pminer->epoch = epoch;
+    pminer->rebased = 0;
+
+    if (pminer->running)
+        return 1;
+
+    error = clSetKernelArgSVMPointer(pminer->kernel, 0, pminer->state);
+    fCheckError(error);
+    error = clSetKernelArg(pminer->kernel, 1, sizeof(cl_uint), &chunkSize);
+    fCheckError(error);
+
+    error = clEnqueueNDRangeKernel(pminer->miner->commandQueue, pminer->kernel, 3, NULL, pminer->workSize,
+                                   NULL, 0, NULL, NULL);
+    fCheckError(error);
+    error = clFlush(pminer->miner->commandQueue);
+    fCheckError(error);
+
+    pminer->running = 1;
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+// Moves shares of the current job out of the ring, shares of older jobs are discarded
+int pollPersistentShares(PERSISTENT_MINER *pminer, SHARE *shares, int maxShares) {
+#ifdef CL_VERSION_2_0
+    PERSISTENT_STATE *state = pminer->state;
+    cl_uint previous = (pminer->epoch - 1) & PERSISTENT_EPOCH_MASK;
+    cl_ulong work = atomic_load_explicit(&state->work, memory_order_relaxed);
+    cl_uint tail = atomic_load_explicit(&state->shareTail, memory_order_relaxed);
+    cl_uint head = atomic_load_explicit(&state->shareHead, memory_order_acquire);
+    cl_uint dropped = atomic_load_explicit(&state->dropped, memory_order_relaxed);
+    int count = 0;
+
+    if (dropped != pminer->dropped) {
+        fprintf(stderr, "Share ring full, %u shares were dropped\n", dropped - pminer->dropped);
+        pminer->dropped = dropped;
+    }
+
+    while (tail != head && count < maxShares) {
+        PERSISTENT_SHARE *share = &state->shares[tail % PERSISTENT_RING_SIZE];
+        // Claimed by a work item but not written yet
+        if (atomic_load_explicit(&share->ready, memory_order_acquire) != tail + 1)
+            break;
+
+        if (share->epoch == pminer->epoch || (pminer->rebased && share->epoch == previous)) {
+            memcpy(shares[count].prehash, pminer->jobs[share->epoch & 1].prehash, 64);
+            shares[count].nonce = share->nonce;
+            count++;
+        }
+        tail++;
+    }
+    atomic_store_explicit(&state->shareTail, tail, memory_order_release);
+
+    if (pminer->running && (work & PERSISTENT_CHUNK_MASK) >= PERSISTENT_REBASE_CHUNKS)
+        rebasePersistentJob(pminer, work);
+
+    return count;
+#else
+    return 0;
+#endif
+}
+
+void stopPersistent(PERSISTENT_MINER *pminer) {
+#ifdef CL_VERSION_2_0
+    if (!pminer->running)
+        return;
+
+    atomic_store_explicit(&pminer->state->stop, 1, memory_order_release);
+    clFinish(pminer->miner->commandQueue);
+    atomic_store_explicit(&pminer->state->stop, 0, memory_order_relaxed);
+    pminer->running = 0;
+#endif
+}
+
+void releasePersistent(PERSISTENT_MINER *pminer) {
+#ifdef CL_VERSION_2_0
+    stopPersistent(pminer);
+    if (pminer->state != NULL)
+        clSVMFree(pminer->miner->context, pminer->state);
+    if (pminer->kernel != NULL)
+        clReleaseKernel(pminer->kernel);
+#endif
+}
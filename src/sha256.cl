@@ -108,21 +108,9 @@ void sha256round(uchar *data, uint *state) {
     state[7] += h;
 }
 
-__kernel void sha256(__global uint *hashedPrehash, __global uchar *result, const ulong startNonce, const uint difficultyMask) {
-    const int id = get_global_id(0) + get_global_id(1) * get_global_size(0) + get_global_id(2) * get_global_size(0) * get_global_size(1);
-    const ulong nonce = id + startNonce;
+// Hashes the prehash (already absorbed into state) followed by "," and the decimal nonce
+void hashNonce(ulong nonce, uint *state) {
     uchar padded[64];
-    uint state[8];
-
-    result[id] = 0;
-    state[0] = hashedPrehash[0];
-    state[1] = hashedPrehash[1];
-    state[2] = hashedPrehash[2];
-    state[3] = hashedPrehash[3];
-    state[4] = hashedPrehash[4];
-    state[5] = hashedPrehash[5];
-    state[6] = hashedPrehash[6];
-    state[7] = hashedPrehash[7];
 
     padded[0] = ',';
     char n = ito10(nonce, padded + 1);
@@ -136,6 +124,132 @@ __kernel void sha256(__global uint *hashedPrehash, __global uchar *result, const
     padded[62] = bitlen >> 8;
 
     sha256round(padded, state);
-    if ((state[0] & difficultyMask) == 0)
+}
+
+// Compares the digest with a big-endian 256-bit target, only called once the first words are equal
+bool meetsTarget(const uint *state, __global const uint *target) {
+    for (int i = 1; i < 8; i++) {
+        if (state[i] != target[i])
+            return state[i] < target[i];
+    }
+    return true;
+}
+
+bool isShare(const uint *state, __global const uint *target, const uint difficultyMask) {
+    if ((state[0] & difficultyMask) != 0 || state[0] > target[0])
+        return false;
+    return state[0] < target[0] || meetsTarget(state, target);
+}
+
+// job holds the midstate of the prehash (8 words) followed by the target (8 words)
+__kernel void sha256(__global uint *job, __global uchar *result, const ulong startNonce, const uint difficultyMask) {
+    const int id = get_global_id(0) + get_global_id(1) * get_global_size(0) + get_global_id(2) * get_global_size(0) * get_global_size(1);
+    const ulong nonce = id + startNonce;
+    uint state[8];
+
+    result[id] = 0;
+    state[0] = job[0];
+    state[1] = job[1];
+    state[2] = job[2];
+    state[3] = job[3];
+    state[4] = job[4];
+    state[5] = job[5];
+    state[6] = job[6];
+    state[7] = job[7];
+
+    hashNonce(nonce, state);
+    if (isShare(state, job + 8, difficultyMask))
         result[id] = 1;
 }
+
+// Writes the first digestBytes bytes of every digest, big-endian, one after the other
+__kernel void sha256Digest(__global uint *job, __global uchar *digests, const ulong startNonce, const uint digestBytes) {
+    const int id = get_global_id(0) + get_global_id(1) * get_global_size(0) + get_global_id(2) * get_global_size(0) * get_global_size(1);
+    __global uchar *digest = digests + (size_t) id * digestBytes;
+    uint state[8];
+
+    for (int i = 0; i < 8; i++)
+        state[i] = job[i];
+
+    hashNonce(startNonce + id, state);
+    for (uint i = 0; i < digestBytes; i++)
+        digest[i] = state[i / 4] >> (24 - (i % 4) * 8);
+}
+
+#if __OPENCL_C_VERSION__ >= 200
+
+#pragma OPENCL EXTENSION cl_khr_int64_base_atomics : enable
+#pragma OPENCL EXTENSION cl_khr_int64_extended_atomics : enable
+
+// These mirror the PERSISTENT_* structs in persistent.h
+typedef struct {
+    uint difficultyMask;
+    uint reserved;
+    ulong startNonce;
+    uint hashedPrehash[8];
+    uint target[8];
+} persistent_job;
+
+typedef struct {
+    ulong nonce;
+    uint epoch;
+    atomic_uint ready;
+} persistent_share;
+
+typedef struct {
+    atomic_ulong work;
+    atomic_uint stop;
+    atomic_uint shareHead;
+    atomic_uint shareTail;
+    atomic_uint dropped;
+    persistent_job jobs[2];
+    persistent_share shares[PERSISTENT_RING_SIZE];
+} persistent_state;
+
+void publishShare(__global persistent_state *pstate, ulong nonce, uint epoch) {
+    uint head = atomic_load_explicit(&pstate->shareHead, memory_order_relaxed, memory_scope_all_svm_devices);
+    uint tail;
+
+    do {
+        tail = atomic_load_explicit(&pstate->shareTail, memory_order_acquire, memory_scope_all_svm_devices);
+        if (head - tail >= PERSISTENT_RING_SIZE) {
+            atomic_fetch_add_explicit(&pstate->dropped, 1, memory_order_relaxed, memory_scope_all_svm_devices);
+            return;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&pstate->shareHead, &head, head + 1, memory_order_relaxed,
+                                                    memory_order_relaxed, memory_scope_all_svm_devices));
+
+    __global persistent_share *share = &pstate->shares[head % PERSISTENT_RING_SIZE];
+    share->nonce = nonce;
+    share->epoch = epoch;
+    atomic_store_explicit(&share->ready, head + 1, memory_order_release, memory_scope_all_svm_devices);
+}
+
+// Runs until the host sets stop. Every pass claims the next chunk of nonces; the epoch in the high bits of
+// work says which job slot the chunk belongs to, so the host switches jobs by storing a new epoch.
+__kernel void sha256Persistent(__global persistent_state *pstate, const uint chunkSize) {
+    uint prehash[8];
+    uint state[8];
+
+    while (!atomic_load_explicit(&pstate->stop, memory_order_relaxed, memory_scope_all_svm_devices)) {
+        ulong work = atomic_fetch_add_explicit(&pstate->work, 1, memory_order_acquire, memory_scope_all_svm_devices);
+        uint epoch = work >> PERSISTENT_EPOCH_SHIFT;
+        __global persistent_job *job = &pstate->jobs[epoch & 1];
+        ulong base = job->startNonce + (work & ((1UL << PERSISTENT_EPOCH_SHIFT) - 1)) * chunkSize;
+        uint difficultyMask = job->difficultyMask;
+
+        for (int i = 0; i < 8; i++)
+            prehash[i] = job->hashedPrehash[i];
+
+        for (uint i = 0; i < chunkSize; i++) {
+            for (int j = 0; j < 8; j++)
+                state[j] = prehash[j];
+
+            hashNonce(base + i, state);
+            if (isShare(state, job->target, difficultyMask))
+                publishShare(pstate, base + i, epoch);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,282 @@
+/*
+MIT License
+
+Copyright (c) 2019 iagocq
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <jseminer/sha256.cl.h>
+
+char *sha256CLSource = R"SHA256_CL_SOURCE(/*
+MIT License
+
+Copyright (c) 2019 iagocq
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#define ROR(a,b) ((a>>b)|(a<<(32-b)))
+
+#define CH(x,y,z) ((x&y)^(~x&z))
+#define MAJ(x,y,z) ((x&y)^(x&z)^(y&z))
+#define EP0(x) (ROR(x,2)^ROR(x,13)^ROR(x,22))
+#define EP1(x) (ROR(x,6)^ROR(x,11)^ROR(x,25))
+#define SIG0(x) (ROR(x,7)^ROR(x,18)^(x>>3))
+#define SIG1(x) (ROR(x,17)^ROR(x,19)^(x>>10))
+
+__constant const uint k[64] = {
+   0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+   0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+   0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+   0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+   0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+   0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+   0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+   0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+char ito10(ulong num, uchar* buf) {
+    char r;
+    char s;
+    char n = 0;
+
+    uchar *cpy = buf;
+
+    if (num == 0) {
+        *buf++ = '0';
+        n = 1;
+    }
+    while (num) {
+        r = num % 10;
+        s = '0' + r;
+        num /= 10;
+        *buf++ = s;
+        n++;
+    }
+    while (cpy < buf) {
+        s = *(--buf);
+        *buf = *cpy;
+        *cpy++ = s;
+    }
+    return n;
+}
+
+void sha256round(uchar *data, uint *state) {
+    uint a, b, c, d, e, f, g, h, i, j, t1, t2, m[64];
+
+    for (i = 0, j = 0; i < 16; ++i, j += 4)
+        m[i] = (data[j] << 24) | (data[j + 1] << 16) | (data[j + 2] << 8) | (data[j + 3]);
+    for ( ; i < 64; ++i)
+        m[i] = SIG1(m[i - 2]) + m[i - 7] + SIG0(m[i - 15]) + m[i - 16];
+
+    a = state[0];
+    b = state[1];
+    c = state[2];
+    d = state[3];
+    e = state[4];
+    f = state[5];
+    g = state[6];
+    h = state[7];
+
+    for (i = 0; i < 64; ++i) {
+        t1 = h + EP1(e) + CH(e,f,g) + k[i] + m[i];
+        t2 = EP0(a) + MAJ(a,b,c);
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+// Hashes the prehash (already absorbed into state) followed by "," and the decimal nonce
+void hashNonce(ulong nonce, uint *state) {
+    uchar padded[64];
+
+    padded[0] = ',';
+    char n = ito10(nonce, padded + 1);
+    padded[n + 1] = 0x80;
+    for (int i = n + 2; i < 62; i++) {
+        padded[i] = 0;
+    }
+
+    uint bitlen = (65 + n) * 8;
+    padded[63] = bitlen;
+    padded[62] = bitlen >> 8;
+
+    sha256round(padded, state);
+}
+
+// Compares the digest with a big-endian 256-bit target, only called once the first words are equal
+bool meetsTarget(const uint *state, __global const uint *target) {
+    for (int i = 1; i < 8; i++) {
+        if (state[i] != target[i])
+            return state[i] < target[i];
+    }
+    return true;
+}
+
+bool isShare(const uint *state, __global const uint *target, const uint difficultyMask) {
+    if ((state[0] & difficultyMask) != 0 || state[0] > target[0])
+        return false;
+    return state[0] < target[0] || meetsTarget(state, target);
+}
+
+// job holds the midstate of the prehash (8 words) followed by the target (8 words)
+__kernel void sha256(__global uint *job, __global uchar *result, const ulong startNonce, const uint difficultyMask) {
+    const int id = get_global_id(0) + get_global_id(1) * get_global_size(0) + get_global_id(2) * get_global_size(0) * get_global_size(1);
+    const ulong nonce = id + startNonce;
+    uint state[8];
+
+    result[id] = 0;
+    state[0] = job[0];
+    state[1] = job[1];
+    state[2] = job[2];
+    state[3] = job[3];
+    state[4] = job[4];
+    state[5] = job[5];
+    state[6] = job[6];
+    state[7] = job[7];
+
+    hashNonce(nonce, state);
+    if (isShare(state, job + 8, difficultyMask))
+        result[id] = 1;
+}
+
+// Writes the first digestBytes bytes of every digest, big-endian, one after the other
+__kernel void sha256Digest(__global uint *job, __global uchar *digests, const ulong startNonce, const uint digestBytes) {
+    const int id = get_global_id(0) + get_global_id(1) * get_global_size(0) + get_global_id(2) * get_global_size(0) * get_global_size(1);
+    __global uchar *digest = digests + (size_t) id * digestBytes;
+    uint state[8];
+
+    for (int i = 0; i < 8; i++)
+        state[i] = job[i];
+
+    hashNonce(startNonce + id, state);
+    for (uint i = 0; i < digestBytes; i++)
+        digest[i] = state[i / 4] >> (24 - (i % 4) * 8);
+}
+
+#if __OPENCL_C_VERSION__ >= 200
+
+#pragma OPENCL EXTENSION cl_khr_int64_base_atomics : enable
+#pragma OPENCL EXTENSION cl_khr_int64_extended_atomics : enable
+
+// These mirror the PERSISTENT_* structs in persistent.h
+typedef struct {
+    uint difficultyMask;
+    uint reserved;
+    ulong startNonce;
+    uint hashedPrehash[8];
+    uint target[8];
+} persistent_job;
+
+typedef struct {
+    ulong nonce;
+    uint epoch;
+    atomic_uint ready;
+} persistent_share;
+
+typedef struct {
+    atomic_ulong work;
+    atomic_uint stop;
+    atomic_uint shareHead;
+    atomic_uint shareTail;
+    atomic_uint dropped;
+    persistent_job jobs[2];
+    persistent_share shares[PERSISTENT_RING_SIZE];
+} persistent_state;
+
+void publishShare(__global persistent_state *pstate, ulong nonce, uint epoch) {
+    uint head = atomic_load_explicit(&pstate->shareHead, memory_order_relaxed, memory_scope_all_svm_devices);
+    uint tail;
+
+    do {
+        tail = atomic_load_explicit(&pstate->shareTail, memory_order_acquire, memory_scope_all_svm_devices);
+        if (head - tail >= PERSISTENT_RING_SIZE) {
+            atomic_fetch_add_explicit(&pstate->dropped, 1, memory_order_relaxed, memory_scope_all_svm_devices);
+            return;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&pstate->shareHead, &head, head + 1, memory_order_relaxed,
+                                                    memory_order_relaxed, memory_scope_all_svm_devices));
+
+    __global persistent_share *share = &pstate->shares[head % PERSISTENT_RING_SIZE];
+    share->nonce = nonce;
+    share->epoch = epoch;
+    atomic_store_explicit(&share->ready, head + 1, memory_order_release, memory_scope_all_svm_devices);
+}
+
+// Runs until the host sets stop. Every pass claims the next chunk of nonces; the epoch in the high bits of
+// work says which job slot the chunk belongs to, so the host switches jobs by storing a new epoch.
+__kernel void sha256Persistent(__global persistent_state *pstate, const uint chunkSize) {
+    uint prehash[8];
+    uint state[8];
+
+    while (!atomic_load_explicit(&pstate->stop, memory_order_relaxed, memory_scope_all_svm_devices)) {
+        ulong work = atomic_fetch_add_explicit(&pstate->work, 1, memory_order_acquire, memory_scope_all_svm_devices);
+        uint epoch = work >> PERSISTENT_EPOCH_SHIFT;
+        __global persistent_job *job = &pstate->jobs[epoch & 1];
+        ulong base = job->startNonce + (work & ((1UL << PERSISTENT_EPOCH_SHIFT) - 1)) * chunkSize;
+        uint difficultyMask = job->difficultyMask;
+
+        for (int i = 0; i < 8; i++)
+            prehash[i] = job->hashedPrehash[i];
+
+        for (uint i = 0; i < chunkSize; i++) {
+            for (int j = 0; j < 8; j++)
+                state[j] = prehash[j];
+
+            hashNonce(base + i, state);
+            if (isShare(state, job->target, difficultyMask))
+                publishShare(pstate, base + i, epoch);
+        }
+    }
+}
+
+#endif
+)SHA256_CL_SOURCE";
@@ -24,7 +24,9 @@ SOFTWARE.
 
 #include <jseminer/socket.h>
 
+#include <errno.h>
 #include <locale.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -51,6 +53,8 @@ int socketInit(void) {
     WSADATA wsa_data;
     return WSAStartup(MAKEWORD(1, 1), &wsa_data);
 #else
+    // A peer that goes away must show up as a failed send, not kill the process
+    signal(SIGPIPE, SIG_IGN);
     return 0;
 #endif
 }
@@ -66,12 +70,13 @@ int socketDeInit(void) {
 int socketClose(LSOCKET *sock) {
     int status = 0;
     SOCKET s = sock->msocket;
+    // shutdown fails on sockets that never connected, but they still have to be closed
 #ifdef _WIN32
-    if ((status = shutdown(s, SD_BOTH)) == 0)
-        status = closesocket(s);
+    shutdown(s, SD_BOTH);
+    status = closesocket(s);
 #else
-    if ((status = shutdown(s, SHUT_RDWR)) == 0)
-        status = close(s);
+    shutdown(s, SHUT_RDWR);
+    status = close(s);
 #endif
     return status;
 }
@@ -92,10 +97,82 @@ int socketConnect(LSOCKET *sock, char *host, unsigned short port) {
     return connect(sock->msocket, (struct sockaddr *) &sock->addr, sizeof(sock->addr));
 }
 
+// Windows reports a failed connect in the except set and never makes the socket writable
+int socketConnectResult(LSOCKET *sock) {
+    fd_set writeset, exceptset;
+    struct timeval timeout = {0, 0};
+    int error = 0;
+    socklen_t len = sizeof(error);
+
+    FD_ZERO(&writeset);
+    FD_ZERO(&exceptset);
+    FD_SET(sock->msocket, &writeset);
+    FD_SET(sock->msocket, &exceptset);
+    if (select(sock->msocket + 1, NULL, &writeset, &exceptset, &timeout) == 0)
+        return 0;
+    if (FD_ISSET(sock->msocket, &exceptset))
+        return -1;
+    if (getsockopt(sock->msocket, SOL_SOCKET, SO_ERROR, (char *) &error, &len) < 0 || error != 0)
+        return -1;
+    return 1;
+}
+
+int socketWouldBlock(void) {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EINPROGRESS || errno == EWOULDBLOCK || errno == EAGAIN;
+#endif
+}
+
+int socketSetBlocking(LSOCKET *sock, int blocking) {
+#ifdef _WIN32
+    u_long mode = !blocking;
+    return ioctlsocket(sock->msocket, FIONBIO, &mode);
+#else
+    int flags = fcntl(sock->msocket, F_GETFL, 0);
+    if (flags < 0)
+        return flags;
+    flags = blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK);
+    return fcntl(sock->msocket, F_SETFL, flags);
+#endif
+}
+
+int socketWaitReadable(LSOCKET *sock, long timeoutMs) {
+    fd_set sockset;
+    struct timeval timeout = {timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+
+    FD_ZERO(&sockset);
+    FD_SET(sock->msocket, &sockset);
+    return select(sock->msocket + 1, &sockset, NULL, NULL, &timeout);
+}
+
 int socketSend(LSOCKET *sock, char *message, int len) { return send(sock->msocket, message, len, 0); }
 
+int socketSendAll(LSOCKET *sock, char *message, int len) {
+    int sent = 0;
+    while (sent < len) {
+        int c = send(sock->msocket, message + sent, len - sent, 0);
+        if (c <= 0)
+            return c;
+        sent += c;
+    }
+    return sent;
+}
+
 int socketRecv(LSOCKET *sock, char *buf, int len) { return recv(sock->msocket, buf, len, 0); }
 
+int socketRecvAll(LSOCKET *sock, char *buf, int len) {
+    int received = 0;
+    while (received < len) {
+        int c = recv(sock->msocket, buf + received, len - received, 0);
+        if (c <= 0)
+            return c;
+        received += c;
+    }
+    return received;
+}
+
 int socketBind(LSOCKET *sock, char *address, unsigned short port) {
     sock->addr.sin_addr.s_addr = inet_addr(address);
     sock->addr.sin_port = htons(port);
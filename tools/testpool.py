@@ -0,0 +1,45 @@
+#!/usr/bin/env python3
+# Minimal stand-in pool for checking client mode by hand, see "Client mode" in the README.
+# Sends one job to the first miner that connects, then prints, checks and acknowledges every share.
+import argparse
+import hashlib
+import socket
+import struct
+
+parser = argparse.ArgumentParser(description="Stand-in pool for miners started with -c")
+parser.add_argument("--port", type=int, default=9855)
+parser.add_argument("--mask", type=lambda x: int(x, 16), default=0xFFFF0000, help="difficulty mask in hex")
+parser.add_argument("--nonce", type=int, default=0, help="start nonce")
+parser.add_argument("--prehash", default="0" * 64, help="64 character prehash")
+args = parser.parse_args()
+
+prehash = args.prehash.encode().ljust(64, b"0")[:64]
+job = b"J" + struct.pack(">IQ", args.mask, args.nonce) + prehash
+
+listener = socket.socket()
+listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+listener.bind(("127.0.0.1", args.port))
+listener.listen(1)
+print("Waiting for a miner on port %d..." % args.port)
+
+while True:
+    conn, address = listener.accept()
+    print("Miner connected from %s:%d" % address)
+    conn.sendall(job)
+    buf = b""
+    while True:
+        data = conn.recv(4096)
+        if not data:
+            print("Miner disconnected")
+            break
+        buf += data
+        while len(buf) >= 73:
+            message, buf = buf[:73], buf[73:]
+            if message[:1] != b"S":
+                print("Unexpected message type %r" % message[:1])
+                continue
+            share_prehash, nonce = message[1:65], struct.unpack(">Q", message[65:73])[0]
+            digest = hashlib.sha256(share_prehash + b"," + str(nonce).encode()).digest()
+            valid = struct.unpack(">I", digest[:4])[0] & args.mask == 0
+            print("Share %d %s" % (nonce, "ok" if valid else "INVALID"))
+            conn.sendall(b"A" + message[1:])